@@ -5,14 +5,106 @@
  */
 #define MMAPTWO_WIN32_DLL_INTERNAL
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#if (defined __linux__) && !(defined _GNU_SOURCE)
+#  define _GNU_SOURCE
+#endif /*__linux__*/
 #include "mmaptwo.h"
 #include <stdlib.h>
 #include <errno.h>
+#include <limits.h>
 
 #ifndef MMAPTWO_MAX_CACHE
 #  define MMAPTWO_MAX_CACHE 1048576
 #endif /*MMAPTWO_MAX_CACHE*/
 
+#ifndef MMAPTWO_HUGE_PAGE
+#  define MMAPTWO_HUGE_PAGE 2097152
+#endif /*MMAPTWO_HUGE_PAGE*/
+
+#ifndef MMAPTWO_GROW_MAX
+#  define MMAPTWO_GROW_MAX 1073741824
+#endif /*MMAPTWO_GROW_MAX*/
+
+#ifndef MMAPTWO_PAGE_POOL
+#  define MMAPTWO_PAGE_POOL 16
+#endif /*MMAPTWO_PAGE_POOL*/
+
+#ifndef MMAPTWO_DIR_FDS
+#  define MMAPTWO_DIR_FDS 64
+#endif /*MMAPTWO_DIR_FDS*/
+
+#ifndef MMAPTWO_PREFETCH_QUEUE
+#  define MMAPTWO_PREFETCH_QUEUE 256
+#endif /*MMAPTWO_PREFETCH_QUEUE*/
+
+#ifndef MMAPTWO_BUF_CACHE
+#  define MMAPTWO_BUF_CACHE 4194304
+#endif /*MMAPTWO_BUF_CACHE*/
+
+#ifndef MMAPTWO_BUF_BLOCK
+#  define MMAPTWO_BUF_BLOCK 65536
+#endif /*MMAPTWO_BUF_BLOCK*/
+
+#ifndef MMAPTWO_URING
+#  define MMAPTWO_URING 0
+#endif /*MMAPTWO_URING*/
+
+#ifndef MMAPTWO_URING_DEPTH
+#  define MMAPTWO_URING_DEPTH 64
+#endif /*MMAPTWO_URING_DEPTH*/
+
+#ifndef MMAPTWO_URING_SLOTS
+#  define MMAPTWO_URING_SLOTS 64
+#endif /*MMAPTWO_URING_SLOTS*/
+
+#ifndef MMAPTWO_URING_SLOT
+#  define MMAPTWO_URING_SLOT 16384
+#endif /*MMAPTWO_URING_SLOT*/
+
+#ifndef MMAPTWO_STATS
+#  define MMAPTWO_STATS 1
+#endif /*MMAPTWO_STATS*/
+
+#ifndef MMAPTWO_USDT
+#  define MMAPTWO_USDT 0
+#endif /*MMAPTWO_USDT*/
+
+/* remembered predictions per instance; also twice the greatest depth */
+#define MMAPTWO_PREFETCH_TABLE 64
+#define MMAPTWO_PREFETCH_WORKERS 64
+
+/* latency histogram buckets: 32 for each power of two past 32 */
+#define MMAPTWO_LATENCY_BUCKETS (32u*(sizeof(size_t)*CHAR_BIT-4u))
+
+/* trace points, as in `struct mmaptwo_trace_hooks` */
+#define MMAPTWO_TRACE_OPEN 0
+#define MMAPTWO_TRACE_ACQUIRE_BEGIN 1
+#define MMAPTWO_TRACE_ACQUIRE_END 2
+#define MMAPTWO_TRACE_PAGE_CLOSE 3
+#define MMAPTWO_TRACE_FLUSH 4
+#define MMAPTWO_TRACE_EXTEND 5
+
+#if (defined ENOSYS)
+#  define MMAPTWO_ENOSYS ENOSYS
+#else
+#  define MMAPTWO_ENOSYS EDOM
+#endif /*ENOSYS*/
+
+#if (defined EWOULDBLOCK)
+#  define MMAPTWO_EWOULDBLOCK EWOULDBLOCK
+#elif (defined EAGAIN)
+#  define MMAPTWO_EWOULDBLOCK EAGAIN
+#else
+#  define MMAPTWO_EWOULDBLOCK ERANGE
+#endif /*EWOULDBLOCK*/
+
+#if (defined ENOMEM)
+#  define MMAPTWO_ENOMEM ENOMEM
+#else
+#  define MMAPTWO_ENOMEM ERANGE
+#endif /*ENOMEM*/
+
 /**
  * \brief Mode tag for `mmaptwo` interface, holding various
  *   mapping configuration values.
@@ -26,6 +118,52 @@ struct mmaptwo_mode_tag {
   char privy;
   /** \brief flag for enabling access from child processes */
   char bequeath;
+  /** \brief flag for mapping the whole source once, at open */
+  char premap;
+  /** \brief flag for sharing mappings among overlapping pages */
+  char share;
+  /** \brief flag for faulting in pages at acquisition */
+  char populate;
+  /** \brief flag for huge page backed mappings */
+  char huge;
+  /** \brief flag for locking mappings in memory */
+  char lock;
+  /** \brief flag for creating and preallocating the file */
+  char create;
+  /** \brief flag for preallocating without growing the file */
+  char keep;
+  /** \brief flag for sealing the length of a memory file */
+  char seal;
+  /** \brief flag for duplicating a caller's file descriptor */
+  char dup;
+  /** \brief flag for copying through reads and writes */
+  char buffer;
+  /** \brief flag for reading acquired ranges through `io_uring` */
+  char uring;
+};
+
+/**
+ * \brief Operation counters, as in \link mmaptwo_stats \endlink.
+ */
+struct mmaptwo_counters {
+  /** \brief number of page handles acquired */
+  size_t volatile acquires;
+  /** \brief number of page handles closed */
+  size_t volatile releases;
+  /** \brief number of failed acquisitions */
+  size_t volatile failures;
+  /** \brief failed acquisitions by `errno` value */
+  size_t volatile errors[mmaptwo_stats_errnos];
+  /** \brief bytes currently mapped */
+  size_t volatile mapped;
+  /** \brief greatest number of bytes mapped at once */
+  size_t volatile peak;
+  /** \brief number of live page handles */
+  size_t volatile pages;
+  /** \brief number of mappings made */
+  size_t volatile maps;
+  /** \brief number of mappings removed */
+  size_t volatile unmaps;
 };
 
 /**
@@ -61,6 +199,33 @@ static struct mmaptwo_mode_tag mmaptwo_mode_parse(char const* mmode);
 #  include <fcntl.h>
 #  include <sys/mman.h>
 #  include <sys/stat.h>
+#  include <sys/resource.h>
+#  include <sched.h>
+#  include <stdio.h>
+#  include <dirent.h>
+#  include <pthread.h>
+#  include <time.h>
+#if (defined __linux__)
+#  include <sys/vfs.h>
+#  ifndef HUGETLBFS_MAGIC
+#    define HUGETLBFS_MAGIC 0x958458f6
+#  endif /*HUGETLBFS_MAGIC*/
+#endif /*__linux__*/
+#if MMAPTWO_URING
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <linux/io_uring.h>
+#endif /*MMAPTWO_URING*/
+#if MMAPTWO_USDT
+#  include <sys/sdt.h>
+#  define MMAPTWO_PROBE(name, m, siz, off, ns, err) \
+     DTRACE_PROBE5(mmaptwo, name, m, siz, off, ns, err)
+#else
+#  define MMAPTWO_PROBE(name, m, siz, off, ns, err) ((void)0)
+#endif /*MMAPTWO_USDT*/
+
+struct mmaptwo_page_unix;
+struct mmaptwo_view_unix;
 
 /**
  * \brief File handler structure for POSIX `mmaptwo` implementation.
@@ -69,13 +234,199 @@ struct mmaptwo_unix {
   /** \brief base structure */
   struct mmaptwo_i base;
   /** \brief length of space */
-  size_t len;
+  size_t volatile len;
   /** \brief offset from start of file to user-requested source */
   size_t offnum;
   /** \brief file descriptor */
   int fd;
   /** \brief open attributes */
   struct mmaptwo_mode_tag mt;
+  /** \brief reference count, held by the map instance and its pages */
+  size_t volatile refs;
+  /** \brief page handle pool free list head (tag and slot number) */
+  size_t volatile pool_head;
+  /** \brief page handle pool */
+  struct mmaptwo_page_unix* pool;
+  /** \brief number of page handles in the pool */
+  size_t pool_size;
+  /** \brief number of page handles taken from the pool */
+  size_t volatile pool_hits;
+  /** \brief number of page handles taken from the heap */
+  size_t volatile pool_misses;
+  /** \brief whole-source `mmap` pointer, for premap mode */
+  void* premap_ptr;
+  /** \brief length of whole-source mapping */
+  size_t premap_len;
+  /** \brief offset from `premap_ptr` to start of source */
+  size_t premap_shift;
+  /** \brief lock for the window cache and the closed flag */
+  size_t volatile cache_lock;
+  /** \brief most recently released page in the window cache */
+  struct mmaptwo_page_unix* cache_head;
+  /** \brief least recently released page in the window cache */
+  struct mmaptwo_page_unix* cache_tail;
+  /** \brief window cache budget in bytes */
+  size_t cache_max;
+  /** \brief bytes of mappings held by the window cache */
+  size_t cache_bytes;
+  /** \brief number of acquisitions served by the window cache */
+  size_t cache_hits;
+  /** \brief number of acquisitions not served by the window cache */
+  size_t cache_misses;
+  /** \brief number of mappings evicted from the window cache */
+  size_t cache_evictions;
+  /** \brief nonzero after the map instance closes */
+  int closed;
+  /** \brief lock for the shared view index */
+  size_t volatile view_lock;
+  /** \brief live shared views, sorted by file offset */
+  struct mmaptwo_view_unix* views;
+  /** \brief access pattern advice for new mappings */
+  size_t volatile advice;
+  /** \brief alignment of file offsets for new mappings */
+  size_t align;
+  /** \brief nonzero if the file lives on `hugetlbfs` */
+  int hugetlb;
+  /** \brief bytes locked in memory by mappings of this instance */
+  size_t volatile locked;
+  /** \brief lock for growing the file, held across blocking calls */
+  pthread_mutex_t grow_lock;
+  /**
+   * \brief file size left by growing past the mappable area,
+   *   or zero if the file holds no extra length
+   */
+  size_t grown;
+  /** \brief directory context, or `NULL` if opened on its own */
+  struct mmaptwo_dir* dir;
+  /** \brief file name relative to the directory context */
+  char* name;
+  /** \brief device of the file, to detect replacement on reopen */
+  dev_t dev;
+  /** \brief inode of the file, to detect replacement on reopen */
+  ino_t ino;
+  /** \brief number of system calls using the file descriptor */
+  size_t fd_busy;
+  /** \brief more recently used instance of the directory context */
+  struct mmaptwo_unix* fd_prev;
+  /** \brief less recently used instance of the directory context */
+  struct mmaptwo_unix* fd_next;
+  /** \brief nonzero while prefetching from acquisition history */
+  size_t volatile pf_on;
+  /** \brief nonzero if prefetching was ever on */
+  size_t volatile pf_used;
+  /** \brief lock for the prefetch detector */
+  size_t volatile pf_lock;
+  /** \brief offset of the last acquisition */
+  size_t pf_last;
+  /** \brief distance between the last two acquisitions */
+  size_t pf_stride;
+  /** \brief number of times in a row the stride repeated */
+  size_t pf_repeat;
+  /** \brief offsets of remembered predictions */
+  size_t pf_off[MMAPTWO_PREFETCH_TABLE];
+  /** \brief sizes of remembered predictions, zero for none */
+  size_t pf_siz[MMAPTWO_PREFETCH_TABLE];
+  /** \brief next slot to replace among remembered predictions */
+  size_t pf_next;
+  /** \brief prefetch counters */
+  struct mmaptwo_prefetch_stats pf_stats;
+  /** \brief number of workers prefetching for this instance */
+  size_t pf_running;
+  /** \brief operation counters */
+  struct mmaptwo_counters stats;
+};
+
+/**
+ * \brief Predicted range waiting for a prefetch worker.
+ */
+struct mmaptwo_prefetch_job {
+  /** \brief map instance */
+  struct mmaptwo_unix* mu;
+  /** \brief offset of the range */
+  size_t off;
+  /** \brief size of the range */
+  size_t siz;
+};
+
+/**
+ * \brief Process-wide prefetch engine.
+ */
+struct mmaptwo_prefetch_engine {
+  /** \brief lock for everything below */
+  pthread_mutex_t lock;
+  /** \brief signal for new jobs and for stopping */
+  pthread_cond_t work;
+  /** \brief signal for finished jobs */
+  pthread_cond_t idle;
+  /** \brief nonzero while the workers run */
+  int running;
+  /** \brief nonzero while the workers are stopping */
+  int stop;
+  /** \brief number of ranges to predict ahead */
+  size_t volatile depth;
+  /** \brief number of worker threads */
+  size_t workers;
+  /** \brief worker threads */
+  pthread_t threads[MMAPTWO_PREFETCH_WORKERS];
+  /** \brief queue of jobs */
+  struct mmaptwo_prefetch_job queue[MMAPTWO_PREFETCH_QUEUE];
+  /** \brief index of the oldest job */
+  size_t head;
+  /** \brief number of queued jobs */
+  size_t count;
+};
+
+/**
+ * \brief Latency histograms of one thread.
+ */
+struct mmaptwo_latency_block {
+  /** \brief operation counts by operation and bucket */
+  size_t volatile counts[mmaptwo_latency_ops][MMAPTWO_LATENCY_BUCKETS];
+  /** \brief nonzero while a thread records into this block */
+  size_t volatile owned;
+  /** \brief next block of the process */
+  struct mmaptwo_latency_block* next;
+};
+
+/**
+ * \brief Process-wide list of latency histograms.
+ */
+struct mmaptwo_latency_list {
+  /** \brief lock for the list */
+  pthread_mutex_t lock;
+  /** \brief guard for creating the key */
+  pthread_once_t once;
+  /** \brief key for each thread's block */
+  pthread_key_t key;
+  /** \brief nonzero if the key exists */
+  int ready;
+  /** \brief first block */
+  struct mmaptwo_latency_block* head;
+};
+
+/**
+ * \brief Directory context, sharing one directory descriptor and
+ *   a budget of open file descriptors.
+ */
+struct mmaptwo_dir {
+  /** \brief directory file descriptor */
+  int fd;
+  /** \brief reference count, held by the owner and each instance */
+  size_t volatile refs;
+  /** \brief lock for the descriptor list and counters */
+  size_t volatile lock;
+  /** \brief most recently used instance */
+  struct mmaptwo_unix* lru_head;
+  /** \brief least recently used instance */
+  struct mmaptwo_unix* lru_tail;
+  /** \brief budget of open file descriptors */
+  size_t max;
+  /** \brief number of open file descriptors */
+  size_t fds;
+  /** \brief number of reopened file descriptors */
+  size_t reopens;
+  /** \brief number of file descriptors closed to stay within budget */
+  size_t closes;
 };
 
 /**
@@ -92,14 +443,90 @@ struct mmaptwo_page_unix {
   size_t shift;
   /** \brief offset from start of source to user-requested space */
   size_t offnum;
+  /** \brief source map instance */
+  struct mmaptwo_unix* src;
+  /** \brief pool slot number, or zero if taken from the heap */
+  size_t slot;
+  /** \brief next free pool slot number, or zero at end of list */
+  size_t volatile pool_next;
+  /** \brief nonzero if the mapping belongs to the source instance */
+  int borrow;
+  /** \brief length of the `mmap` region */
+  size_t maplen;
+  /** \brief offset from start of file to `ptr` */
+  size_t mapoff;
+  /** \brief next more recently released page in the window cache */
+  struct mmaptwo_page_unix* lru_prev;
+  /** \brief next less recently released page in the window cache */
+  struct mmaptwo_page_unix* lru_next;
+  /** \brief shared view holding the mapping, or NULL */
+  struct mmaptwo_view_unix* view;
+  /** \brief bytes locked in memory through this page */
+  size_t locked;
+  /** \brief nonzero if the page locks its pages as they fault in */
+  int lock_onfault;
 };
 
 /**
- * \brief Convert a wide string to a multibyte string.
- * \param nm the string to convert
- * \return a multibyte string on success, `NULL` otherwise
+ * \brief Shared mapping structure for POSIX `mmaptwo` implementation.
  */
-static char* mmaptwo_wctomb(wchar_t const* nm);
+struct mmaptwo_view_unix {
+  /** \brief `mmap` pointer */
+  void* ptr;
+  /** \brief length of the `mmap` region */
+  size_t len;
+  /** \brief offset from start of file to `ptr` */
+  size_t off;
+  /** \brief number of pages using this view */
+  size_t refs;
+  /** \brief previous view in the index */
+  struct mmaptwo_view_unix* prev;
+  /** \brief next view in the index */
+  struct mmaptwo_view_unix* next;
+};
+
+/**
+ * \brief Entry of a batch acquisition, sorted by offset.
+ */
+struct mmaptwo_batch_unix {
+  /** \brief offset of the range */
+  size_t off;
+  /** \brief size of the range */
+  size_t siz;
+  /** \brief index of the range in the caller's array */
+  size_t idx;
+};
+
+/**
+ * \brief Ring buffer mapped twice, back to back.
+ */
+struct mmaptwo_ring {
+  /** \brief start of the reserved region, twice the capacity long */
+  unsigned char* base;
+  /** \brief capacity in bytes, a multiple of the page size */
+  size_t cap;
+  /** \brief producer cursor, in `[0, 2*cap)` */
+  size_t volatile head;
+  /** \brief consumer cursor, in `[0, 2*cap)` */
+  size_t volatile tail;
+  /** \brief reference count, held by the owner and each view */
+  size_t volatile refs;
+};
+
+/**
+ * \brief Page instance viewing the readable span of a ring buffer.
+ */
+struct mmaptwo_ring_page {
+  struct mmaptwo_page_i base;
+  /** \brief source ring buffer */
+  struct mmaptwo_ring* src;
+  /** \brief start of the span */
+  unsigned char* ptr;
+  /** \brief length of the span */
+  size_t len;
+  /** \brief offset of the span inside the ring */
+  size_t off;
+};
 
 /**
  * \brief Convert a `mmaptwo` mode character to a POSIX `open` flag.
@@ -123,6 +550,13 @@ static int mmaptwo_mode_prot_cvt(int mmode);
  */
 static int mmaptwo_mode_flag_cvt(int mprivy);
 
+/**
+ * \brief Convert a create flag to `open` flags.
+ * \param mcreate create flag
+ * \return the flags to add for `open`
+ */
+static int mmaptwo_mode_create_cvt(int mcreate);
+
 /**
  * \brief Fetch a file size from a file descriptor.
  * \param fd target file descriptor
@@ -140,326 +574,4463 @@ static size_t mmaptwo_file_size_e(int fd);
  */
 static struct mmaptwo_i* mmaptwo_open_rest
   (int fd, struct mmaptwo_mode_tag const mmode, size_t sz, size_t off);
-#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
-#  define WIN32_LEAN_AND_MEAN
-#  include <windows.h>
-#  include <limits.h>
-#  if (defined EILSEQ)
-#    define MMAPTWO_EILSEQ EILSEQ
-#  else
-#    define MMAPTWO_EILSEQ EDOM
-#  endif /*EILSEQ*/
 
 /**
- * \brief File handler structure for Win32 API `mmaptwo` implementation.
+ * \brief Finish preparing a memory map interface, without timing.
+ * \param fd file descriptor
+ * \param mmode mode tag
+ * \param sz size of range to map
+ * \param off offset from start of file
+ * \return an interface on success, NULL otherwise
  */
-struct mmaptwo_win32 {
-  /** \brief base structure */
-  struct mmaptwo_i base;
-  /** \brief length of space, including unrequested leading bytes */
-  size_t len;
-  /** \brief file mapping handle */
-  HANDLE fmd;
-  /** \brief file handle */
-  HANDLE fd;
-  /** \brief user-requested offset from start of file */
-  size_t offnum;
-  /** \brief open attributes */
-  struct mmaptwo_mode_tag mt;
-};
+static struct mmaptwo_i* mmaptwo_open_map
+  (int fd, struct mmaptwo_mode_tag const mmode, size_t sz, size_t off);
 
 /**
- * \brief Page handler structure for Win32 API `mmaptwo` implementation.
+ * \brief Drop a reference to a map instance, freeing the instance
+ *   after the last reference.
+ * \param mu map instance
  */
-struct mmaptwo_page_win32 {
-  /** \brief base structure */
-  struct mmaptwo_page_i base;
-  /** \brief `MapViewOfFile` pointer */
-  void* ptr;
-  /** \brief length of space */
-  size_t len;
-  /** \brief offset from `ptr` to start of user-requested space */
-  size_t shift;
-  /** \brief user-requested offset from start of source */
-  size_t offnum;
-};
+static void mmaptwo_unix_release(struct mmaptwo_unix* mu);
 
 /**
- * \brief Convert a `mmaptwo` mode character to a `CreateFile.`
- *   desired access flag.
- * \param mmode the character to convert
- * \return an `CreateFile.` desired access flag on success, zero otherwise
+ * \brief Take a page handle from a map instance's pool, or from the heap
+ *   if the pool is empty.
+ * \param mu map instance
+ * \return a page handle on success, NULL otherwise
  */
-static DWORD mmaptwo_mode_rw_cvt(int mmode);
+static struct mmaptwo_page_unix* mmaptwo_pool_take(struct mmaptwo_unix* mu);
 
 /**
- * \brief Convert a `mmaptwo` mode character to a `CreateFile.`
- *   creation disposition.
- * \param mmode the character to convert
- * \return a `CreateFile.` creation disposition on success, zero otherwise
+ * \brief Return a page handle to its pool, or to the heap.
+ * \param mu map instance
+ * \param pu page handle to return
  */
-static DWORD mode_disposition_cvt(int mmode);
+static void mmaptwo_pool_give
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu);
 
 /**
- * \brief Convert UTF-8 encoded text to UTF-16 LE text.
- * \param nm file name encoded in UTF-8
- * \param[out] out output string
- * \param[out] outlen output length
- * \return an `errno` code
+ * \brief Check the page handle pool counters.
+ * \param m map instance
+ * \param[out] hits number of page handles taken from the pool
+ * \param[out] misses number of page handles taken from the heap
+ * \return zero on success, an `errno` code otherwise
  */
-static int mmaptwo_u8towc_shim
-  (unsigned char const* nm, wchar_t* out, size_t* outlen);
+static int mmaptwo_mmt_pool_stats
+  (struct mmaptwo_i const* m, size_t* hits, size_t* misses);
 
 /**
- * \brief Convert UTF-8 encoded text to UTF-16 LE text.
- * \param nm file name encoded in UTF-8
- * \return a wide string on success, NULL otherwise
+ * \brief Map the whole source of a map instance.
+ * \param mu map instance
+ * \return zero on success, nonzero otherwise
  */
-static wchar_t* mmaptwo_u8towc(unsigned char const* nm);
+static int mmaptwo_premap(struct mmaptwo_unix* mu);
 
 /**
- * \brief Finish preparing a memory map interface.
- * \param fd file handle
- * \param mmode mode text
- * \param sz size of range to map
- * \param off offset from start of file
- * \return an interface on success, NULL otherwise
+ * \brief Take a mapping covering the given range from the window cache.
+ * \param mu map instance
+ * \param sz size of range
+ * \param off offset of range from start of file
+ * \return a page handle owning the mapping on success, NULL otherwise
  */
-static struct mmaptwo_i* mmaptwo_open_rest
-  (HANDLE fd, struct mmaptwo_mode_tag const mmode, size_t sz, size_t off);
+static struct mmaptwo_page_unix* mmaptwo_cache_take
+  (struct mmaptwo_unix* mu, size_t sz, size_t off);
 
 /**
- * \brief Fetch a file size from a file descriptor.
- * \param fd target file handle
- * \return a file size, or zero on failure
+ * \brief Put a released page's mapping in the window cache.
+ * \param mu map instance
+ * \param pu page handle to release
+ * \return nonzero if the cache kept the mapping, zero otherwise
  */
-static size_t mmaptwo_file_size_e(HANDLE fd);
+static int mmaptwo_cache_give
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu);
 
 /**
- * \brief Convert a `mmaptwo` mode character to a
- *   `CreateFileMapping.` protection flag.
- * \param mmode the character to convert
- * \return a `CreateFileMapping.` protection flag on success, zero otherwise
+ * \brief Detach pages from the window cache until it fits a budget.
+ * \param mu map instance, with cache lock held
+ * \param max budget in bytes
+ * \return a list of detached pages, linked by `lru_next`
  */
-static DWORD mmaptwo_mode_prot_cvt(int mmode);
+static struct mmaptwo_page_unix* mmaptwo_cache_trim
+  (struct mmaptwo_unix* mu, size_t max);
 
 /**
- * \brief Convert a `mmaptwo` mode tag to a `MapViewOfFile`
- *   desired access flag.
- * \param mt the tag to convert
- * \return a `MapViewOfFile` desired access flag on success, zero otherwise
+ * \brief Unmap and free pages detached from the window cache.
+ * \param mu map instance
+ * \param pu list of detached pages, linked by `lru_next`
  */
-static DWORD mmaptwo_mode_access_cvt(struct mmaptwo_mode_tag const mt);
-#endif /*MMAPTWO_OS*/
+static void mmaptwo_cache_drop
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu);
 
 /**
- * \brief Destructor; closes the file and frees the space.
+ * \brief Set the window cache budget.
  * \param m map instance
+ * \param max budget in bytes; zero disables the cache
+ * \return zero on success, an `errno` code otherwise
  */
-static void mmaptwo_mmt_dtor(struct mmaptwo_i* m);
+static int mmaptwo_mmt_set_cache(struct mmaptwo_i* m, size_t max);
 
 /**
- * \brief Destructor; closes the page and frees the space.
+ * \brief Check the window cache counters.
+ * \param m map instance
+ * \param[out] st counters
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmt_cache_stats
+  (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st);
+
+/**
+ * \brief Find a live shared view covering the given range, and
+ *   add a reference to it.
+ * \param mu map instance
+ * \param sz size of range
+ * \param off offset of range from start of file
+ * \return a view on success, NULL otherwise
+ */
+static struct mmaptwo_view_unix* mmaptwo_view_find
+  (struct mmaptwo_unix* mu, size_t sz, size_t off);
+
+/**
+ * \brief Add a new shared view to the index.
+ * \param mu map instance
+ * \param ptr `mmap` pointer
+ * \param len length of the `mmap` region
+ * \param off offset from start of file to `ptr`
+ * \param refs number of pages holding the view at publication
+ * \return the view on success, NULL otherwise
+ */
+static struct mmaptwo_view_unix* mmaptwo_view_add
+  (struct mmaptwo_unix* mu, void* ptr, size_t len, size_t off, size_t refs);
+
+/**
+ * \brief Drop a reference to a shared view.
+ * \param mu map instance
+ * \param v the view to release
+ * \return nonzero if that was the last reference, in which case the
+ *   view has left the index and the caller owns its mapping
+ */
+static int mmaptwo_view_release
+  (struct mmaptwo_unix* mu, struct mmaptwo_view_unix* v);
+
+/**
+ * \brief Apply access pattern advice to a mapped range.
+ * \param ptr page-aligned start of range
+ * \param len length of range
+ * \param advice a \link mmaptwo_advice \endlink value
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_madvise(void* ptr, size_t len, int advice);
+
+/**
+ * \brief Set the access pattern advice for new mappings.
+ * \param m map instance
+ * \param advice a \link mmaptwo_advice \endlink value
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmt_advise(struct mmaptwo_i* m, int advice);
+
+/**
+ * \brief Apply access pattern advice to the mapped area.
  * \param p page instance
+ * \param advice a \link mmaptwo_advice \endlink value
+ * \return zero on success, an `errno` code otherwise
  */
-static void mmaptwo_mmtp_dtor(struct mmaptwo_page_i* p);
+static int mmaptwo_mmtp_advise(struct mmaptwo_page_i* p, int advice);
 
 /**
- * \brief Acquire a page of the space.
+ * \brief Acquire a page of the space, counting failures.
  * \param m map instance
  * \param sz size of page instance to request
  * \param off offset of page from start of map instance
+ * \param flags bitwise OR of \link mmaptwo_acquire_flag \endlink values
  * \return pointer to page instance on success, NULL otherwise
  */
-static struct mmaptwo_page_i* mmaptwo_mmt_acquire
-  (struct mmaptwo_i* m, size_t sz, size_t off);
+static struct mmaptwo_page_i* mmaptwo_mmt_acquire_flags
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags);
 
 /**
- * \brief Check the length of the mappable area.
+ * \brief Acquire a page of the space.
  * \param m map instance
- * \return the length of the mapped region exposed by this interface
+ * \param sz size of page instance to request
+ * \param off offset of page from start of map instance
+ * \param flags bitwise OR of \link mmaptwo_acquire_flag \endlink values
+ * \param[out] mapped set to nonzero if the page needed a new mapping
+ *   (optional)
+ * \return pointer to page instance on success, NULL otherwise
  */
-static size_t mmaptwo_mmt_length(struct mmaptwo_i const* m);
+static struct mmaptwo_page_i* mmaptwo_mmt_acquire_page
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags, int* mapped);
 
 /**
- * \brief Check the length of the mapped area.
- * \param p page instance
- * \return the length of the mapped region exposed by this interface
+ * \brief Fill in a page instance for a prepared mapping.
+ * \param mu map instance
+ * \param out page instance
+ * \param ptr start of the mapping
+ * \param fullshift distance from `ptr` to the requested range
+ * \param sz size of the requested range
+ * \param pre_off offset of the requested range
  */
-static size_t mmaptwo_mmtp_length(struct mmaptwo_page_i const* p);
+static void mmaptwo_page_init
+  ( struct mmaptwo_unix* mu, struct mmaptwo_page_unix* out, void* ptr,
+    size_t fullshift, size_t sz, size_t pre_off);
 
 /**
- * \brief Check the offset of the mappable area.
+ * \brief Acquire many ranges at once, counting failures.
  * \param m map instance
- * \return the offset of the mappable exposed by this interface, from start
- *   of file
+ * \param n number of ranges
+ * \param ranges ranges to acquire
+ * \param[out] pages page instances, one for each range
+ * \param flags acquisition flags
+ * \param[out] saved mappings saved, or `NULL`
+ * \return zero on success, an `errno` code otherwise
  */
-static size_t mmaptwo_mmt_offset(struct mmaptwo_i const* m);
+static int mmaptwo_mmt_acquire_batch
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved);
 
 /**
- * \brief Check the offset of the mapped area.
- * \param p page instance
- * \return the offset of the mapped region exposed by this interface,
- *   from start of source mappable
+ * \brief Acquire many ranges at once.
+ * \param m map instance
+ * \param n number of ranges
+ * \param ranges ranges to acquire
+ * \param[out] pages page instances, one for each range
+ * \param flags acquisition flags
+ * \param[out] saved mappings saved, or `NULL`
+ * \return zero on success, an `errno` code otherwise
  */
-static size_t mmaptwo_mmtp_offset(struct mmaptwo_page_i const* p);
+static int mmaptwo_mmt_acquire_group
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved);
 
 /**
- * \brief Get the start of the mapped area.
- * \param p page instance
- * \return a pointer to the start of the requested mapped area
+ * \brief Get the operation counters.
+ * \param m map instance
+ * \param[out] st counters
+ * \param reset nonzero to zero the counters after reading them
+ * \return zero on success, an `errno` code otherwise
  */
-static void* mmaptwo_mmtp_get(struct mmaptwo_page_i* p);
+static int mmaptwo_mmt_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset);
 
 /**
- * \brief Get the start of the mapped area.
- * \param p page instance
- * \return a pointer to the start of the requested mapped area
+ * \brief Get the file descriptor of the mapped file.
+ * \param m map instance
+ * \return the file descriptor, or -1 for directory instances
  */
-static void const* mmaptwo_mmtp_getconst(struct mmaptwo_page_i const* p);
+static int mmaptwo_mmt_fd(struct mmaptwo_i const* m);
 
+/**
+ * \brief Hold the file descriptor of a map instance open for a system
+ *   call, reopening it if the directory context closed it.
+ * \param mu map instance
+ * \return the file descriptor on success, -1 otherwise
+ */
+static int mmaptwo_fd_hold(struct mmaptwo_unix* mu);
 
-/* BEGIN static functions */
-struct mmaptwo_mode_tag mmaptwo_mode_parse(char const* mmode) {
-  struct mmaptwo_mode_tag out = { 0, 0, 0, 0 };
-  int i;
-  for (i = 0; i < 8; ++i) {
-    switch (mmode[i]) {
-    case 0: /* NUL termination */
-      return out;
-    case mmaptwo_mode_write:
-      out.mode = mmaptwo_mode_write;
-      break;
-    case mmaptwo_mode_read:
-      out.mode = mmaptwo_mode_read;
-      break;
-    case mmaptwo_mode_end:
-      out.end = mmaptwo_mode_end;
-      break;
-    case mmaptwo_mode_private:
-      out.privy = mmaptwo_mode_private;
-      break;
-    case mmaptwo_mode_bequeath:
-      out.bequeath = mmaptwo_mode_bequeath;
-      break;
-    }
-  }
-  return out;
-}
+/**
+ * \brief Let the directory context close a held file descriptor again.
+ * \param mu map instance
+ */
+static void mmaptwo_fd_drop(struct mmaptwo_unix* mu);
 
-#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+/**
+ * \brief Take the least recently used idle file descriptor away from
+ *   its instance if the directory is over its budget.
+ * \param d directory context, locked
+ * \param keep instance whose descriptor must stay open
+ * \return a descriptor for the caller to close after unlocking,
+ *   or -1 for none
+ */
+static int mmaptwo_dir_trim
+  (struct mmaptwo_dir* d, struct mmaptwo_unix* keep);
+
+/**
+ * \brief Drop a reference to a directory context.
+ * \param d directory context
+ */
+static void mmaptwo_dir_release(struct mmaptwo_dir* d);
+
+/**
+ * \brief Turn prefetching from acquisition history on or off.
+ * \param m map instance
+ * \param on nonzero to turn on, zero to turn off
+ * \return zero
+ */
+static int mmaptwo_mmt_set_prefetch(struct mmaptwo_i* m, int on);
+
+/**
+ * \brief Get the prefetch counters.
+ * \param m map instance
+ * \param[out] st counters
+ * \return zero
+ */
+static int mmaptwo_mmt_prefetch_stats
+  (struct mmaptwo_i* m, struct mmaptwo_prefetch_stats* st);
+
+/**
+ * \brief Feed an acquisition to the prefetch detector, queueing
+ *   predicted ranges.
+ * \param mu map instance
+ * \param off offset of the acquisition
+ * \param sz size of the acquisition
+ */
+static void mmaptwo_prefetch_note
+  (struct mmaptwo_unix* mu, size_t off, size_t sz);
+
+/**
+ * \brief Discard queued predictions of a closing map instance, and wait
+ *   for workers still prefetching for it.
+ * \param mu map instance
+ */
+static void mmaptwo_prefetch_detach(struct mmaptwo_unix* mu);
+
+/**
+ * \brief Start bringing a range into the page cache without waiting.
+ * \param mu map instance
+ * \param off offset of the range from start of map instance
+ * \param sz size of the range
+ * \note The range goes to the prefetch workers if they run and have
+ *   room, or else to the kernel as a `POSIX_FADV_WILLNEED` hint.
+ */
+static void mmaptwo_populate_async
+  (struct mmaptwo_unix* mu, size_t off, size_t sz);
+
+/**
+ * \brief Check that a range is in the page cache, else start bringing
+ *   it in.
+ * \param mu map instance
+ * \param off offset of the range from start of map instance
+ * \param sz size of the range
+ * \return zero if resident, `EWOULDBLOCK` if not, or another `errno`
+ *   code on failure
+ */
+static int mmaptwo_mmt_resident
+  (struct mmaptwo_unix* mu, size_t off, size_t sz);
+
+/**
+ * \brief Entry point of a prefetch worker.
+ * \param arg unused
+ * \return `NULL`
+ */
+static void* mmaptwo_prefetch_main(void* arg);
+
+/**
+ * \brief Compare batch entries by file offset, for `qsort`.
+ * \param a first entry
+ * \param b second entry
+ * \return negative, zero or positive like `strcmp`
+ */
+static int mmaptwo_batch_cmp(void const* a, void const* b);
+
+
+/**
+ * \brief Fault in the pages of a page handle's range.
+ * \param mu map instance
+ * \param pu page handle
+ */
+static void mmaptwo_populate
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu);
+
+/**
+ * \brief Map a range of a file descriptor held for a map instance.
+ * \param mu map instance
+ * \param fd file descriptor from \link mmaptwo_fd_hold \endlink
+ * \param[in,out] len length of range, rounded up if the mapping
+ *   needs whole huge pages
+ * \param off offset of range from start of file, a multiple of
+ *   the instance's alignment
+ * \param flags extra `mmap` flags
+ * \return an `mmap` pointer on success, `MAP_FAILED` otherwise
+ */
+static void* mmaptwo_map_fd
+  (struct mmaptwo_unix* mu, int fd, size_t* len, size_t off, int flags);
+
+/**
+ * \brief Map a range of the file of a map instance.
+ * \param mu map instance
+ * \param[in,out] len length of range, rounded up if the mapping
+ *   needs whole huge pages
+ * \param off offset of range from start of file, a multiple of
+ *   the instance's alignment
+ * \param flags extra `mmap` flags
+ * \return an `mmap` pointer on success, `MAP_FAILED` otherwise
+ */
+static void* mmaptwo_map
+  (struct mmaptwo_unix* mu, size_t* len, size_t off, int flags);
+
+/**
+ * \brief Choose the alignment of file offsets for new mappings.
+ * \param mu map instance
+ */
+static void mmaptwo_align_init(struct mmaptwo_unix* mu);
+
+/**
+ * \brief Unmap a mapping of a map instance.
+ * \param mu map instance
+ * \param ptr `mmap` pointer
+ * \param len length of the `mmap` region
+ */
+static void mmaptwo_unmap(struct mmaptwo_unix* mu, void* ptr, size_t len);
+
+/**
+ * \brief Check the number of bytes locked in memory.
+ * \param m map instance
+ * \return a byte count
+ */
+static size_t mmaptwo_mmt_locked(struct mmaptwo_i const* m);
+
+/**
+ * \brief Lock the mapped area in memory.
+ * \param p page instance
+ * \param onfault nonzero to lock pages as they fault in, zero to
+ *   fault in and lock all pages now
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmtp_lock(struct mmaptwo_page_i* p, int onfault);
+
+/**
+ * \brief Unlock the mapped area.
+ * \param p page instance
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmtp_unlock(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Write changes in part of the mapped area to the file.
+ * \param p page instance
+ * \param sz size of the part to flush
+ * \param off offset of the part from start of page
+ * \param flags bitwise OR of \link mmaptwo_flush_flag \endlink values
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmtp_flush
+  (struct mmaptwo_page_i* p, size_t sz, size_t off, int flags);
+
+/**
+ * \brief Flush part of a page, without timing.
+ * \param p page instance
+ * \param sz size of the range
+ * \param off offset of the range from start of page
+ * \param flags bitwise OR of \link mmaptwo_flush_flag \endlink values
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmtp_sync
+  (struct mmaptwo_page_i* p, size_t sz, size_t off, int flags);
+
+/**
+ * \brief Grow a file, allocating its new blocks where possible.
+ * \param fd file descriptor
+ * \param cur current size of file
+ * \param sz new size of file
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_file_grow(int fd, size_t cur, size_t sz);
+
+/**
+ * \brief Preallocate a file region for a newly opened map instance.
+ * \param fd file descriptor
+ * \param mt mode tag
+ * \param sz size of the region
+ * \param off file offset of the region
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_file_reserve
+  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off);
+
+/**
+ * \brief Create an unnamed memory file.
+ * \param nm name to show for debugging
+ * \param mt mode tag
+ * \param[in,out] sz size of the file, rounded up to the file's page size
+ * \return a file descriptor on success, -1 otherwise
+ */
+static int mmaptwo_memfd
+  (char const* nm, struct mmaptwo_mode_tag const mt, size_t* sz);
+
+/**
+ * \brief Drop a reference to a ring buffer, unmapping it at zero.
+ * \param r the ring buffer
+ */
+static void mmaptwo_ring_release(struct mmaptwo_ring* r);
+
+/**
+ * \brief Advance a ring cursor.
+ * \param r the ring buffer
+ * \param pos the cursor
+ * \param n byte count
+ * \return the new cursor value
+ */
+static size_t mmaptwo_ring_step
+  (struct mmaptwo_ring const* r, size_t pos, size_t n);
+
+/**
+ * \brief Destructor for a ring view.
+ * \param p page instance
+ */
+static void mmaptwo_ringp_dtor(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the start of a ring view.
+ * \param p page instance
+ * \return the start of the span
+ */
+static void* mmaptwo_ringp_get(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the start of a ring view.
+ * \param p page instance
+ * \return the start of the span
+ */
+static void const* mmaptwo_ringp_getconst(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Get the length of a ring view.
+ * \param p page instance
+ * \return the length of the span
+ */
+static size_t mmaptwo_ringp_length(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Get the offset of a ring view inside its ring buffer.
+ * \param p page instance
+ * \return the offset of the span
+ */
+static size_t mmaptwo_ringp_offset(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Extend the mappable area, growing the file if needed.
+ * \param m map instance
+ * \param sz new length of the mappable area
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmt_extend(struct mmaptwo_i* m, size_t sz);
+
+/**
+ * \brief Extend the mappable area, without tracing.
+ * \param m map instance
+ * \param sz new length of the mappable area
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmt_grow(struct mmaptwo_i* m, size_t sz);
+
+/**
+ * \brief Change the length of the mapped area.
+ * \param p page instance
+ * \param sz new length of the mapped area
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmtp_resize(struct mmaptwo_page_i* p, size_t sz);
+
+/**
+ * \brief Check which pages of a mapped range are in memory.
+ * \param ptr page-aligned start of a mapping
+ * \param lead offset of the range from `ptr`
+ * \param sz size of the range
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the range in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mincore
+  ( void* ptr, size_t lead, size_t sz, unsigned char* bits,
+    size_t* resident);
+
+/**
+ * \brief Check which pages of a range of a file are in the page cache.
+ * \param fd file descriptor
+ * \param off file offset of the range
+ * \param sz size of the range
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the range in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_file_residency
+  ( int fd, size_t off, size_t sz, unsigned char* bits,
+    size_t* resident);
+
+/**
+ * \brief Check which pages of a range are in the page cache.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the range in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmt_residency
+  ( struct mmaptwo_i* m, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident);
+
+/**
+ * \brief Check which pages of part of a page are in memory.
+ * \param p page instance
+ * \param sz size of the part
+ * \param off offset of the part from start of page
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the part in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_mmtp_residency
+  ( struct mmaptwo_page_i* p, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident);
+
+/**
+ * \brief Check that a range of a file is in the page cache, else hint
+ *   the kernel to bring it in.
+ * \param fd file descriptor
+ * \param off file offset of the range
+ * \param sz size of the range
+ * \return zero if resident, `EWOULDBLOCK` if not, or another `errno`
+ *   code on failure
+ */
+static int mmaptwo_file_resident(int fd, size_t off, size_t sz);
+
+/**
+ * \brief Read a monotonic clock, if anything needs the time.
+ * \return the time in nanoseconds, modulo the range of `size_t`,
+ *   or zero if nothing needs the time
+ */
+static size_t mmaptwo_clock_now(void);
+
+/**
+ * \brief Measure the time since an earlier reading of the clock.
+ * \param start \link mmaptwo_clock_now \endlink before the operation
+ * \return the duration in nanoseconds, or zero if `start` is zero
+ */
+static size_t mmaptwo_clock_since(size_t start);
+
+/**
+ * \brief Add a timed operation to the calling thread's histogram.
+ * \param op a \link mmaptwo_latency_op \endlink value
+ * \param ns duration of the operation in nanoseconds
+ */
+static void mmaptwo_latency_record(int op, size_t ns);
+
+/**
+ * \brief Fire a trace point.
+ * \param point a `MMAPTWO_TRACE_*` value
+ * \param m map instance
+ * \param siz size of the range
+ * \param off offset of the range into the file data
+ * \param ns duration of the operation in nanoseconds
+ * \param err zero, or the `errno` code of a failure
+ */
+static void mmaptwo_trace_emit
+  ( int point, struct mmaptwo_i const* m, size_t siz, size_t off,
+    size_t ns, int err);
+
+#if MMAPTWO_STATS
+/**
+ * \brief Create the key for each thread's histograms.
+ */
+static void mmaptwo_latency_init(void);
+
+/**
+ * \brief Give up a thread's histograms at thread exit, for another
+ *   thread to take over.
+ * \param arg the thread's block
+ */
+static void mmaptwo_latency_exit(void* arg);
+
+/**
+ * \brief Find or make the calling thread's histograms.
+ * \return the histograms, or `NULL` if unavailable
+ */
+static struct mmaptwo_latency_block* mmaptwo_latency_get(void);
+
+/**
+ * \brief Find the histogram bucket for a latency.
+ * \param ns latency in nanoseconds
+ * \return the bucket index
+ */
+static size_t mmaptwo_latency_bucket(size_t ns);
+
+/**
+ * \brief Find the greatest latency of a histogram bucket.
+ * \param idx the bucket index
+ * \return the latency in nanoseconds
+ */
+static size_t mmaptwo_latency_bound(size_t idx);
+#endif /*MMAPTWO_STATS*/
+#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  include <limits.h>
+#  if (defined EILSEQ)
+#    define MMAPTWO_EILSEQ EILSEQ
+#  else
+#    define MMAPTWO_EILSEQ EDOM
+#  endif /*EILSEQ*/
+
+/**
+ * \brief File handler structure for Win32 API `mmaptwo` implementation.
+ */
+struct mmaptwo_win32 {
+  /** \brief base structure */
+  struct mmaptwo_i base;
+  /** \brief length of space, including unrequested leading bytes */
+  size_t len;
+  /** \brief file mapping handle */
+  HANDLE fmd;
+  /** \brief file handle */
+  HANDLE fd;
+  /** \brief user-requested offset from start of file */
+  size_t offnum;
+  /** \brief open attributes */
+  struct mmaptwo_mode_tag mt;
+};
+
+/**
+ * \brief Page handler structure for Win32 API `mmaptwo` implementation.
+ */
+struct mmaptwo_page_win32 {
+  /** \brief base structure */
+  struct mmaptwo_page_i base;
+  /** \brief `MapViewOfFile` pointer */
+  void* ptr;
+  /** \brief length of space */
+  size_t len;
+  /** \brief offset from `ptr` to start of user-requested space */
+  size_t shift;
+  /** \brief user-requested offset from start of source */
+  size_t offnum;
+};
+
+/**
+ * \brief Convert a `mmaptwo` mode character to a `CreateFile.`
+ *   desired access flag.
+ * \param mmode the character to convert
+ * \return an `CreateFile.` desired access flag on success, zero otherwise
+ */
+static DWORD mmaptwo_mode_rw_cvt(int mmode);
+
+/**
+ * \brief Convert a `mmaptwo` mode character to a `CreateFile.`
+ *   creation disposition.
+ * \param mmode the character to convert
+ * \return a `CreateFile.` creation disposition on success, zero otherwise
+ */
+static DWORD mode_disposition_cvt(int mmode);
+
+/**
+ * \brief Convert UTF-8 encoded text to UTF-16 LE text.
+ * \param nm file name encoded in UTF-8
+ * \param[out] out output string
+ * \param[out] outlen output length
+ * \return an `errno` code
+ */
+static int mmaptwo_u8towc_shim
+  (unsigned char const* nm, wchar_t* out, size_t* outlen);
+
+/**
+ * \brief Convert UTF-8 encoded text to UTF-16 LE text.
+ * \param nm file name encoded in UTF-8
+ * \return a wide string on success, NULL otherwise
+ */
+static wchar_t* mmaptwo_u8towc(unsigned char const* nm);
+
+/**
+ * \brief Finish preparing a memory map interface.
+ * \param fd file handle
+ * \param mmode mode text
+ * \param sz size of range to map
+ * \param off offset from start of file
+ * \return an interface on success, NULL otherwise
+ */
+static struct mmaptwo_i* mmaptwo_open_rest
+  (HANDLE fd, struct mmaptwo_mode_tag const mmode, size_t sz, size_t off);
+
+/**
+ * \brief Fetch a file size from a file descriptor.
+ * \param fd target file handle
+ * \return a file size, or zero on failure
+ */
+static size_t mmaptwo_file_size_e(HANDLE fd);
+
+/**
+ * \brief Convert a `mmaptwo` mode character to a
+ *   `CreateFileMapping.` protection flag.
+ * \param mmode the character to convert
+ * \return a `CreateFileMapping.` protection flag on success, zero otherwise
+ */
+static DWORD mmaptwo_mode_prot_cvt(int mmode);
+
+/**
+ * \brief Convert a `mmaptwo` mode tag to a `MapViewOfFile`
+ *   desired access flag.
+ * \param mt the tag to convert
+ * \return a `MapViewOfFile` desired access flag on success, zero otherwise
+ */
+static DWORD mmaptwo_mode_access_cvt(struct mmaptwo_mode_tag const mt);
+#endif /*MMAPTWO_OS*/
+
+/*
+ * atomic operations: GNU builtins, Win32 interlocked functions,
+ *   or plain (thread-unsafe) operations as a last resort
+ */
+#if (defined __GNUC__) && ((__GNUC__ > 4) \
+    || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7) || (defined __clang__))
+#  define MMAPTWO_ATOMIC 1
+#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
+#  define MMAPTWO_ATOMIC 2
+#else
+#  define MMAPTWO_ATOMIC 0
+#endif /*MMAPTWO_ATOMIC*/
+
+/* the `io_uring` rings need acquire and release ordering */
+#if MMAPTWO_URING && (MMAPTWO_ATOMIC != 1 \
+    || !(defined __NR_io_uring_setup) || !(defined IORING_FEAT_SINGLE_MMAP))
+#  undef MMAPTWO_URING
+#  define MMAPTWO_URING 0
+#endif /*MMAPTWO_URING*/
+
+/**
+ * \brief Atomically read a value.
+ * \param p pointer to the value
+ * \return the value
+ */
+static size_t mmaptwo_atomic_get(size_t volatile const* p);
+
+/**
+ * \brief Atomically write a value.
+ * \param p pointer to the value
+ * \param v new value
+ */
+static void mmaptwo_atomic_set(size_t volatile* p, size_t v);
+
+/**
+ * \brief Atomically add to a value.
+ * \param p pointer to the value
+ * \param v amount to add
+ * \return the value after the addition
+ */
+static size_t mmaptwo_atomic_add(size_t volatile* p, size_t v);
+
+/**
+ * \brief Atomically replace a value if it matches an expected value.
+ * \param p pointer to the value
+ * \param expect the expected value
+ * \param v new value
+ * \return nonzero if replaced, zero otherwise
+ */
+static int mmaptwo_atomic_cas(size_t volatile* p, size_t expect, size_t v);
+
+/**
+ * \brief Acquire a spin lock, yielding the processor while waiting.
+ * \param p pointer to the lock value
+ */
+static void mmaptwo_spin_lock(size_t volatile* p);
+
+/**
+ * \brief Release a spin lock.
+ * \param p pointer to the lock value
+ */
+static void mmaptwo_spin_unlock(size_t volatile* p);
+
+#if MMAPTWO_STATS
+/**
+ * \brief Add to a counter, without ordering other memory accesses.
+ * \param p pointer to the counter
+ * \param v amount to add
+ * \return the counter after the addition
+ */
+static size_t mmaptwo_stat_add(size_t volatile* p, size_t v);
+#endif /*MMAPTWO_STATS*/
+
+#if MMAPTWO_OS != MMAPTWO_OS_WIN32
+/**
+ * \brief Count an acquired page handle.
+ * \param c counters of the instance
+ */
+static void mmaptwo_stat_acquire(struct mmaptwo_counters* c);
+
+/**
+ * \brief Count a failed acquisition.
+ * \param c counters of the instance
+ * \param err the `errno` code of the failure
+ */
+static void mmaptwo_stat_fail(struct mmaptwo_counters* c, int err);
+
+/**
+ * \brief Count a closed page handle.
+ * \param c counters of the instance
+ */
+static void mmaptwo_stat_release(struct mmaptwo_counters* c);
+#endif /*MMAPTWO_OS*/
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+/**
+ * \brief Count a new mapping, or the growth of one.
+ * \param c counters of the instance
+ * \param len bytes added
+ * \param fresh nonzero for a new mapping
+ */
+static void mmaptwo_stat_map
+  (struct mmaptwo_counters* c, size_t len, int fresh);
+
+/**
+ * \brief Count a removed mapping, or the shrinking of one.
+ * \param c counters of the instance
+ * \param len bytes removed
+ * \param gone nonzero for a removed mapping
+ */
+static void mmaptwo_stat_unmap
+  (struct mmaptwo_counters* c, size_t len, int gone);
+#endif /*MMAPTWO_OS*/
+
+/**
+ * \brief Take a snapshot of a set of counters.
+ * \param c counters
+ * \param[out] st snapshot
+ * \param reset nonzero to zero the event counts after reading them
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_stat_read
+  (struct mmaptwo_counters* c, struct mmaptwo_stats* st, int reset);
+
+/* pool free list heads hold a slot number in the low half, tag in the high */
+#define MMAPTWO_POOL_MASK \
+  ((((size_t)1u)<<(sizeof(size_t)*CHAR_BIT/2u))-1u)
+
+/**
+ * \brief Page handle pool size for newly opened map instances.
+ */
+static size_t volatile mmaptwo_pool_default = MMAPTWO_PAGE_POOL;
+
+/**
+ * \brief Operation counters summed over every map instance.
+ */
+static struct mmaptwo_counters mmaptwo_stats_global;
+
+/**
+ * \brief Address of the tracing callbacks, or zero for none.
+ */
+static size_t volatile mmaptwo_trace_table = 0u;
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+/**
+ * \brief Prefetch engine shared by all map instances.
+ */
+static struct mmaptwo_prefetch_engine mmaptwo_prefetch = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  PTHREAD_COND_INITIALIZER, 0, 0, 0u, 0u, { 0 }, { { NULL, 0u, 0u } },
+  0u, 0u
+};
+
+#  if MMAPTWO_STATS
+/**
+ * \brief Latency histograms of every thread.
+ */
+static struct mmaptwo_latency_list mmaptwo_latency = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, 0, NULL
+};
+#  endif /*MMAPTWO_STATS*/
+#endif /*MMAPTWO_OS*/
+
+/**
+ * \brief Destructor; closes the file and frees the space.
+ * \param m map instance
+ */
+static void mmaptwo_mmt_dtor(struct mmaptwo_i* m);
+
+/**
+ * \brief Destructor; closes the page and frees the space.
+ * \param p page instance
+ */
+static void mmaptwo_mmtp_dtor(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Acquire a page of the space.
+ * \param m map instance
+ * \param sz size of page instance to request
+ * \param off offset of page from start of map instance
+ * \return pointer to page instance on success, NULL otherwise
+ */
+static struct mmaptwo_page_i* mmaptwo_mmt_acquire
+  (struct mmaptwo_i* m, size_t sz, size_t off);
+
+/**
+ * \brief Check the length of the mappable area.
+ * \param m map instance
+ * \return the length of the mapped region exposed by this interface
+ */
+static size_t mmaptwo_mmt_length(struct mmaptwo_i const* m);
+
+/**
+ * \brief Check the length of the mapped area.
+ * \param p page instance
+ * \return the length of the mapped region exposed by this interface
+ */
+static size_t mmaptwo_mmtp_length(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Check the offset of the mappable area.
+ * \param m map instance
+ * \return the offset of the mappable exposed by this interface, from start
+ *   of file
+ */
+static size_t mmaptwo_mmt_offset(struct mmaptwo_i const* m);
+
+/**
+ * \brief Check the offset of the mapped area.
+ * \param p page instance
+ * \return the offset of the mapped region exposed by this interface,
+ *   from start of source mappable
+ */
+static size_t mmaptwo_mmtp_offset(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Get the start of the mapped area.
+ * \param p page instance
+ * \return a pointer to the start of the requested mapped area
+ */
+static void* mmaptwo_mmtp_get(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the start of the mapped area.
+ * \param p page instance
+ * \return a pointer to the start of the requested mapped area
+ */
+static void const* mmaptwo_mmtp_getconst(struct mmaptwo_page_i const* p);
+
+#if MMAPTWO_OS != MMAPTWO_OS_WIN32
+#  include <stdio.h>
+#  include <string.h>
+#if (defined __STDC_VERSION__) && (__STDC_VERSION__ >= 199501L)
+#  include <wchar.h>
+#endif /*__STDC_VERSION__*/
+
+/**
+ * \brief Convert a wide string to a multibyte string.
+ * \param nm the string to convert
+ * \return a multibyte string on success, `NULL` otherwise
+ */
+static char* mmaptwo_wctomb(wchar_t const* nm);
+
+/**
+ * \brief Cached block of a buffered map instance.
+ */
+struct mmaptwo_buf_block {
+  /** \brief file offset of the block, a multiple of the block size */
+  size_t off;
+  /** \brief number of bytes read from the file */
+  size_t len;
+  /** \brief block contents */
+  unsigned char* data;
+  /** \brief more recently used block */
+  struct mmaptwo_buf_block* prev;
+  /** \brief less recently used block */
+  struct mmaptwo_buf_block* next;
+};
+
+/**
+ * \brief File structure for the buffered `mmaptwo` implementation,
+ *   which copies file data with explicit reads and writes.
+ */
+struct mmaptwo_buf {
+  /** \brief base structure */
+  struct mmaptwo_i base;
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  /** \brief file descriptor */
+  int fd;
+#else
+  /** \brief file stream */
+  FILE* fp;
+  /** \brief lock for the stream position */
+  size_t volatile io_lock;
+#endif /*MMAPTWO_OS*/
+  /** \brief mode tag */
+  struct mmaptwo_mode_tag mt;
+  /** \brief offset from start of file */
+  size_t offnum;
+  /** \brief length of the mappable area */
+  size_t volatile len;
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  /** \brief lock for extending the mappable area */
+  pthread_mutex_t grow_lock;
+#endif /*MMAPTWO_OS*/
+  /** \brief reference count, held by the instance and each page */
+  size_t volatile refs;
+  /** \brief lock for the block cache */
+  size_t volatile lock;
+  /** \brief most recently used block */
+  struct mmaptwo_buf_block* head;
+  /** \brief least recently used block */
+  struct mmaptwo_buf_block* tail;
+  /** \brief bytes held in cached blocks */
+  size_t bytes;
+  /** \brief budget in bytes for cached blocks */
+  size_t max;
+  /** \brief number of blocks served by the cache */
+  size_t hits;
+  /** \brief number of blocks read from the file */
+  size_t misses;
+  /** \brief number of blocks evicted to stay within budget */
+  size_t evictions;
+  /** \brief count of writes, to catch reads racing with them */
+  size_t gen;
+  /** \brief operation counters */
+  struct mmaptwo_counters stats;
+};
+
+/**
+ * \brief Page handler structure for the buffered `mmaptwo`
+ *   implementation.
+ */
+struct mmaptwo_buf_page {
+  /** \brief base structure */
+  struct mmaptwo_page_i base;
+  /** \brief source instance */
+  struct mmaptwo_buf* src;
+  /** \brief copy of the file data */
+  unsigned char* data;
+  /** \brief length of the copy */
+  size_t len;
+  /** \brief offset from start of source to the copy */
+  size_t offnum;
+  /** \brief nonzero if the copy may differ from the file */
+  int dirty;
+};
+
+/**
+ * \brief Make a buffered map instance.
+ * \param io file descriptor (Unix) or file stream
+ * \param mt mode tag
+ * \param sz size of the mappable area
+ * \param off file offset of the mappable area
+ * \return an interface on success, `NULL` otherwise
+ */
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+static struct mmaptwo_i* mmaptwo_buf_make
+  (int io, struct mmaptwo_mode_tag const mt, size_t sz, size_t off);
+#else
+static struct mmaptwo_i* mmaptwo_buf_make
+  (FILE* io, struct mmaptwo_mode_tag const mt, size_t sz, size_t off);
+#endif /*MMAPTWO_OS*/
+
+/**
+ * \brief Drop a reference to a buffered map instance, closing the file
+ *   and freeing the cache at zero.
+ * \param b map instance
+ */
+static void mmaptwo_buf_release(struct mmaptwo_buf* b);
+
+/**
+ * \brief Read from the file of a buffered map instance.
+ * \param b map instance
+ * \param dst destination
+ * \param sz number of bytes to read
+ * \param off file offset
+ * \param[out] got number of bytes read before end of file
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_buf_read
+  ( struct mmaptwo_buf* b, unsigned char* dst, size_t sz, size_t off,
+    size_t* got);
+
+/**
+ * \brief Write to the file of a buffered map instance.
+ * \param b map instance
+ * \param src source
+ * \param sz number of bytes to write
+ * \param off file offset
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_buf_write
+  (struct mmaptwo_buf* b, unsigned char const* src, size_t sz, size_t off);
+
+/**
+ * \brief Copy file data through the block cache.
+ * \param b map instance
+ * \param dst destination
+ * \param sz number of bytes to copy
+ * \param off file offset
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_buf_fill
+  (struct mmaptwo_buf* b, unsigned char* dst, size_t sz, size_t off);
+
+/**
+ * \brief Write data to the file, updating cached blocks to match.
+ * \param b map instance
+ * \param src source
+ * \param sz number of bytes to write
+ * \param off file offset
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_buf_store
+  (struct mmaptwo_buf* b, unsigned char const* src, size_t sz, size_t off);
+
+/**
+ * \brief Unlink least recently used blocks beyond a budget.
+ * \param b map instance, with the cache locked
+ * \param max budget in bytes
+ * \return a list of unlinked blocks, to free with
+ *   \link mmaptwo_buf_drop \endlink after unlocking
+ */
+static struct mmaptwo_buf_block* mmaptwo_buf_trim
+  (struct mmaptwo_buf* b, size_t max);
+
+/**
+ * \brief Free a list of blocks.
+ * \param blk first block of the list
+ */
+static void mmaptwo_buf_drop(struct mmaptwo_buf_block* blk);
+
+/**
+ * \brief Destructor; closes the instance once its pages close.
+ * \param m map instance
+ */
+static void mmaptwo_bufm_dtor(struct mmaptwo_i* m);
+
+/**
+ * \brief Acquire a copy of a range of the file.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \return pointer to page instance on success, NULL otherwise
+ */
+static struct mmaptwo_page_i* mmaptwo_bufm_acquire
+  (struct mmaptwo_i* m, size_t sz, size_t off);
+
+/**
+ * \brief Acquire a copy of a range of the file, with options,
+ *   counting failures.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \param flags acquisition flags, which copies need not honor
+ * \return pointer to page instance on success, NULL otherwise
+ */
+static struct mmaptwo_page_i* mmaptwo_bufm_acquire_flags
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags);
+
+/**
+ * \brief Acquire a copy of a range of the file, with options.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \param flags acquisition flags, which copies need not honor
+ * \return pointer to page instance on success, NULL otherwise
+ */
+static struct mmaptwo_page_i* mmaptwo_bufm_acquire_copy
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags);
+
+/**
+ * \brief Get the operation counters.
+ * \param m map instance
+ * \param[out] st counters
+ * \param reset nonzero to zero the counters after reading them
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_bufm_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset);
+
+/**
+ * \brief Check the length of the mappable area.
+ * \param m map instance
+ * \return the length of the mappable area
+ */
+static size_t mmaptwo_bufm_length(struct mmaptwo_i const* m);
+
+/**
+ * \brief Check the offset of the mappable area.
+ * \param m map instance
+ * \return the file offset of the mappable area
+ */
+static size_t mmaptwo_bufm_offset(struct mmaptwo_i const* m);
+
+/**
+ * \brief Set the budget of the block cache.
+ * \param m map instance
+ * \param max budget in bytes
+ * \return zero
+ */
+static int mmaptwo_bufm_set_cache(struct mmaptwo_i* m, size_t max);
+
+/**
+ * \brief Get the block cache counters.
+ * \param m map instance
+ * \param[out] st counters
+ * \return zero
+ */
+static int mmaptwo_bufm_cache_stats
+  (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st);
+
+/**
+ * \brief Destructor; writes back a changed copy and frees the page.
+ * \param p page instance
+ */
+static void mmaptwo_bufp_dtor(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the copy of the file data for writing.
+ * \param p page instance
+ * \return the start of the copy
+ */
+static void* mmaptwo_bufp_get(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the copy of the file data.
+ * \param p page instance
+ * \return the start of the copy
+ */
+static void const* mmaptwo_bufp_getconst(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Check the length of the copy.
+ * \param p page instance
+ * \return the length of the copy
+ */
+static size_t mmaptwo_bufp_length(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Check the offset of the copy.
+ * \param p page instance
+ * \return the offset of the copy from start of map instance
+ */
+static size_t mmaptwo_bufp_offset(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Write part of the copy back to the file.
+ * \param p page instance
+ * \param sz size of the range
+ * \param off offset of the range from start of the page
+ * \param flags bitwise OR of \link mmaptwo_flush_flag \endlink values
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_bufp_flush
+  (struct mmaptwo_page_i* p, size_t sz, size_t off, int flags);
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+/**
+ * \brief Extend the mappable area, growing the file if needed.
+ * \param m map instance
+ * \param sz new length of the mappable area
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_bufm_extend(struct mmaptwo_i* m, size_t sz);
+
+/**
+ * \brief Get the file descriptor.
+ * \param m map instance
+ * \return the file descriptor
+ */
+static int mmaptwo_bufm_fd(struct mmaptwo_i const* m);
+
+/**
+ * \brief Check which pages of a range are in the page cache.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the range in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_bufm_residency
+  ( struct mmaptwo_i* m, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident);
+
+/**
+ * \brief Check which pages of part of the copy are in memory.
+ * \param p page instance
+ * \param sz size of the part
+ * \param off offset of the part from start of page
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the part in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_bufp_residency
+  ( struct mmaptwo_page_i* p, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident);
+#endif /*MMAPTWO_OS*/
+#endif /*MMAPTWO_OS*/
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX && MMAPTWO_URING
+/**
+ * \brief Read request for the `io_uring` implementation.
+ */
+struct mmaptwo_uring_req {
+  /** \brief destination */
+  unsigned char* data;
+  /** \brief number of bytes to read */
+  size_t len;
+  /** \brief file offset */
+  size_t off;
+  /** \brief buffer slot plus one, or zero for an own buffer */
+  size_t slot;
+  /** \brief vector for reads into own buffers */
+  struct iovec iov;
+  /** \brief completion result */
+  int res;
+  /** \brief completion flag */
+  int done;
+};
+
+/**
+ * \brief File structure for the `io_uring` implementation, which
+ *   reads acquired ranges into buffers instead of mapping them.
+ */
+struct mmaptwo_uring {
+  /** \brief base structure */
+  struct mmaptwo_i base;
+  /** \brief file descriptor */
+  int fd;
+  /** \brief ring file descriptor */
+  int ring;
+  /** \brief mode tag */
+  struct mmaptwo_mode_tag mt;
+  /** \brief offset from start of file */
+  size_t offnum;
+  /** \brief length of the mappable area */
+  size_t len;
+  /** \brief reference count, held by the instance and each page */
+  size_t volatile refs;
+  /** \brief lock for the rings and the buffer slots */
+  pthread_mutex_t lock;
+  /** \brief signal for completions reaped */
+  pthread_cond_t reaped;
+  /** \brief whether a thread waits in the kernel for completions */
+  int reaping;
+  /** \brief whether the buffer arena is registered with the ring */
+  int fixed;
+  /** \brief number of requests submitted and not yet reaped */
+  unsigned int inflight;
+  /** \brief number of submission entries */
+  unsigned int depth;
+  /** \brief submission ring mapping */
+  void* sq_ptr;
+  /** \brief length of the submission ring mapping */
+  size_t sq_len;
+  /** \brief completion ring mapping, maybe the same as `sq_ptr` */
+  void* cq_ptr;
+  /** \brief length of the completion ring mapping */
+  size_t cq_len;
+  /** \brief submission entries */
+  struct io_uring_sqe* sqes;
+  /** \brief submission ring head, advanced by the kernel */
+  unsigned int* sq_head;
+  /** \brief submission ring tail */
+  unsigned int* sq_tail;
+  /** \brief submission ring index mask */
+  unsigned int sq_mask;
+  /** \brief submission ring indices into `sqes` */
+  unsigned int* sq_array;
+  /** \brief completion ring head */
+  unsigned int* cq_head;
+  /** \brief completion ring tail, advanced by the kernel */
+  unsigned int* cq_tail;
+  /** \brief completion ring index mask */
+  unsigned int cq_mask;
+  /** \brief completion entries */
+  struct io_uring_cqe* cqes;
+  /** \brief buffer arena */
+  unsigned char* arena;
+  /** \brief stack of free buffer slots */
+  size_t free_slots[MMAPTWO_URING_SLOTS];
+  /** \brief number of free buffer slots */
+  size_t free_count;
+  /** \brief operation counters */
+  struct mmaptwo_counters stats;
+};
+
+/**
+ * \brief Page handler structure for the `io_uring` implementation.
+ */
+struct mmaptwo_uring_page {
+  /** \brief base structure */
+  struct mmaptwo_page_i base;
+  /** \brief source instance */
+  struct mmaptwo_uring* src;
+  /** \brief buffer with the file data */
+  unsigned char* data;
+  /** \brief length of the buffer */
+  size_t len;
+  /** \brief offset from start of source to the buffer */
+  size_t offnum;
+  /** \brief buffer slot plus one, or zero for an own buffer */
+  size_t slot;
+};
+
+/**
+ * \brief Make an `io_uring` map instance.
+ * \param fd file descriptor, left open on failure
+ * \param mt mode tag
+ * \param sz size of the mappable area
+ * \param off file offset of the mappable area
+ * \return an interface on success, `NULL` otherwise
+ */
+static struct mmaptwo_i* mmaptwo_uring_make
+  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off);
+
+/**
+ * \brief Drop a reference to an `io_uring` map instance, closing
+ *   the rings and the file at zero.
+ * \param u map instance
+ */
+static void mmaptwo_uring_release(struct mmaptwo_uring* u);
+
+/**
+ * \brief Unmap the rings and the arena, close the ring and free
+ *   the instance, leaving the file open.
+ * \param u map instance
+ */
+static void mmaptwo_uring_free(struct mmaptwo_uring* u);
+
+/**
+ * \brief Submit read requests and wait for all of them to complete.
+ * \param u map instance
+ * \param n number of requests
+ * \param reqs requests
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_uring_run
+  (struct mmaptwo_uring* u, size_t n, struct mmaptwo_uring_req* reqs);
+
+/**
+ * \brief Move completions from the ring to their requests.
+ * \param u map instance, with the lock held
+ */
+static void mmaptwo_uring_reap(struct mmaptwo_uring* u);
+
+/**
+ * \brief Acquire ranges as buffered pages through one ring run.
+ * \param u map instance
+ * \param n number of ranges
+ * \param ranges ranges to acquire
+ * \param[out] pages page instances, one for each range
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_uring_acquire_many
+  ( struct mmaptwo_uring* u, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages);
+
+/**
+ * \brief Destructor; closes the instance once its pages close.
+ * \param m map instance
+ */
+static void mmaptwo_urm_dtor(struct mmaptwo_i* m);
+
+/**
+ * \brief Acquire a range of the file.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \return pointer to page instance on success, NULL otherwise
+ */
+static struct mmaptwo_page_i* mmaptwo_urm_acquire
+  (struct mmaptwo_i* m, size_t sz, size_t off);
+
+/**
+ * \brief Acquire a range of the file, with options.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \param flags acquisition flags, which buffers need not honor
+ * \return pointer to page instance on success, NULL otherwise
+ */
+static struct mmaptwo_page_i* mmaptwo_urm_acquire_flags
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags);
+
+/**
+ * \brief Acquire many ranges, keeping their reads in flight together.
+ * \param m map instance
+ * \param n number of ranges
+ * \param ranges ranges to acquire
+ * \param[out] pages page instances, one for each range
+ * \param flags acquisition flags, which buffers need not honor
+ * \param[out] saved mappings saved, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_urm_acquire_batch
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved);
+
+/**
+ * \brief Check the length of the mappable area.
+ * \param m map instance
+ * \return the length of the mappable area
+ */
+static size_t mmaptwo_urm_length(struct mmaptwo_i const* m);
+
+/**
+ * \brief Check the offset of the mappable area.
+ * \param m map instance
+ * \return the file offset of the mappable area
+ */
+static size_t mmaptwo_urm_offset(struct mmaptwo_i const* m);
+
+/**
+ * \brief Get the file descriptor.
+ * \param m map instance
+ * \return the file descriptor
+ */
+static int mmaptwo_urm_fd(struct mmaptwo_i const* m);
+
+/**
+ * \brief Get the operation counters.
+ * \param m map instance
+ * \param[out] st counters
+ * \param reset nonzero to zero the counters after reading them
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_urm_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset);
+
+/**
+ * \brief Destructor; returns the buffer and frees the page.
+ * \param p page instance
+ */
+static void mmaptwo_urp_dtor(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the buffer with the file data.
+ * \param p page instance
+ * \return the start of the buffer
+ */
+static void* mmaptwo_urp_get(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Get the buffer with the file data.
+ * \param p page instance
+ * \return the start of the buffer
+ */
+static void const* mmaptwo_urp_getconst(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Check the length of the buffer.
+ * \param p page instance
+ * \return the length of the buffer
+ */
+static size_t mmaptwo_urp_length(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Check the offset of the buffer.
+ * \param p page instance
+ * \return the offset of the buffer from start of map instance
+ */
+static size_t mmaptwo_urp_offset(struct mmaptwo_page_i const* p);
+
+/**
+ * \brief Check which pages of a range are in the page cache.
+ * \param m map instance
+ * \param sz size of the range
+ * \param off offset of the range from start of map instance
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the range in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_urm_residency
+  ( struct mmaptwo_i* m, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident);
+
+/**
+ * \brief Check which pages of part of the buffer are in memory.
+ * \param p page instance
+ * \param sz size of the part
+ * \param off offset of the part from start of page
+ * \param[out] bits bitmap of resident pages, or `NULL`
+ * \param[out] resident bytes of the part in resident pages, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ */
+static int mmaptwo_urp_residency
+  ( struct mmaptwo_page_i* p, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident);
+#endif /*MMAPTWO_OS*/
+
+
+/* BEGIN static functions */
+struct mmaptwo_mode_tag mmaptwo_mode_parse(char const* mmode) {
+  struct mmaptwo_mode_tag out =
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  int i;
+  for (i = 0; i < 16; ++i) {
+    switch (mmode[i]) {
+    case 0: /* NUL termination */
+      return out;
+    case mmaptwo_mode_write:
+      out.mode = mmaptwo_mode_write;
+      break;
+    case mmaptwo_mode_read:
+      out.mode = mmaptwo_mode_read;
+      break;
+    case mmaptwo_mode_end:
+      out.end = mmaptwo_mode_end;
+      break;
+    case mmaptwo_mode_private:
+      out.privy = mmaptwo_mode_private;
+      break;
+    case mmaptwo_mode_bequeath:
+      out.bequeath = mmaptwo_mode_bequeath;
+      break;
+    case mmaptwo_mode_premap:
+      out.premap = mmaptwo_mode_premap;
+      break;
+    case mmaptwo_mode_share:
+      out.share = mmaptwo_mode_share;
+      break;
+    case mmaptwo_mode_populate:
+      out.populate = mmaptwo_mode_populate;
+      break;
+    case mmaptwo_mode_huge:
+      out.huge = mmaptwo_mode_huge;
+      break;
+    case mmaptwo_mode_lock:
+      out.lock = mmaptwo_mode_lock;
+      break;
+    case mmaptwo_mode_create:
+      out.create = mmaptwo_mode_create;
+      break;
+    case mmaptwo_mode_keep:
+      out.keep = mmaptwo_mode_keep;
+      break;
+    case mmaptwo_mode_seal:
+      out.seal = mmaptwo_mode_seal;
+      break;
+    case mmaptwo_mode_dup:
+      out.dup = mmaptwo_mode_dup;
+      break;
+    case mmaptwo_mode_buffer:
+      out.buffer = mmaptwo_mode_buffer;
+      break;
+    case mmaptwo_mode_uring:
+      out.uring = mmaptwo_mode_uring;
+      break;
+    }
+  }
+  return out;
+}
+
+size_t mmaptwo_atomic_get(size_t volatile const* p) {
+#if MMAPTWO_ATOMIC == 1
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif MMAPTWO_ATOMIC == 2
+  MemoryBarrier();
+  return *p;
+#else
+  return *p;
+#endif /*MMAPTWO_ATOMIC*/
+}
+
+void mmaptwo_atomic_set(size_t volatile* p, size_t v) {
+#if MMAPTWO_ATOMIC == 1
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#elif MMAPTWO_ATOMIC == 2
+  *p = v;
+  MemoryBarrier();
+#else
+  *p = v;
+#endif /*MMAPTWO_ATOMIC*/
+  return;
+}
+
+size_t mmaptwo_atomic_add(size_t volatile* p, size_t v) {
+#if MMAPTWO_ATOMIC == 1
+  return __atomic_add_fetch(p, v, __ATOMIC_ACQ_REL);
+#elif MMAPTWO_ATOMIC == 2
+#  if (defined _WIN64)
+  return (size_t)InterlockedExchangeAdd64((LONG64 volatile*)p, (LONG64)v)+v;
+#  else
+  return (size_t)InterlockedExchangeAdd((LONG volatile*)p, (LONG)v)+v;
+#  endif /*_WIN64*/
+#else
+  return (*p += v);
+#endif /*MMAPTWO_ATOMIC*/
+}
+
+int mmaptwo_atomic_cas(size_t volatile* p, size_t expect, size_t v) {
+#if MMAPTWO_ATOMIC == 1
+  return __atomic_compare_exchange_n
+    (p, &expect, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? 1 : 0;
+#elif MMAPTWO_ATOMIC == 2
+#  if (defined _WIN64)
+  return InterlockedCompareExchange64
+    ((LONG64 volatile*)p, (LONG64)v, (LONG64)expect) == (LONG64)expect;
+#  else
+  return InterlockedCompareExchange
+    ((LONG volatile*)p, (LONG)v, (LONG)expect) == (LONG)expect;
+#  endif /*_WIN64*/
+#else
+  if (*p == expect) {
+    *p = v;
+    return 1;
+  } else return 0;
+#endif /*MMAPTWO_ATOMIC*/
+}
+
+void mmaptwo_spin_lock(size_t volatile* p) {
+  while (!mmaptwo_atomic_cas(p, 0u, 1u)) {
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+    sched_yield();
+#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
+    SwitchToThread();
+#endif /*MMAPTWO_OS*/
+  }
+  return;
+}
+
+void mmaptwo_spin_unlock(size_t volatile* p) {
+  mmaptwo_atomic_set(p, 0u);
+  return;
+}
+
+#if MMAPTWO_STATS
+size_t mmaptwo_stat_add(size_t volatile* p, size_t v) {
+#  if MMAPTWO_ATOMIC == 1
+  return __atomic_add_fetch(p, v, __ATOMIC_RELAXED);
+#  else
+  return mmaptwo_atomic_add(p, v);
+#  endif /*MMAPTWO_ATOMIC*/
+}
+#endif /*MMAPTWO_STATS*/
+
+#if MMAPTWO_OS != MMAPTWO_OS_WIN32
+void mmaptwo_stat_acquire(struct mmaptwo_counters* c) {
+#if MMAPTWO_STATS
+  mmaptwo_stat_add(&c->acquires, 1u);
+  mmaptwo_stat_add(&c->pages, 1u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.acquires, 1u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.pages, 1u);
+#else
+  (void)c;
+#endif /*MMAPTWO_STATS*/
+  return;
+}
+
+void mmaptwo_stat_fail(struct mmaptwo_counters* c, int err) {
+#if MMAPTWO_STATS
+  size_t const slot = (err > 0 && err < (int)mmaptwo_stats_errnos)
+    ? (size_t)err : 0u;
+  mmaptwo_stat_add(&c->failures, 1u);
+  mmaptwo_stat_add(&c->errors[slot], 1u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.failures, 1u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.errors[slot], 1u);
+#else
+  (void)c;
+  (void)err;
+#endif /*MMAPTWO_STATS*/
+  return;
+}
+
+void mmaptwo_stat_release(struct mmaptwo_counters* c) {
+#if MMAPTWO_STATS
+  mmaptwo_stat_add(&c->releases, 1u);
+  mmaptwo_stat_add(&c->pages, ~(size_t)0u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.releases, 1u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.pages, ~(size_t)0u);
+#else
+  (void)c;
+#endif /*MMAPTWO_STATS*/
+  return;
+}
+#endif /*MMAPTWO_OS*/
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+void mmaptwo_stat_map
+  (struct mmaptwo_counters* c, size_t len, int fresh)
+{
+#if MMAPTWO_STATS
+  struct mmaptwo_counters* all[2];
+  int i;
+  all[0] = c;
+  all[1] = &mmaptwo_stats_global;
+  for (i = 0; i < 2; ++i) {
+    size_t const now = mmaptwo_stat_add(&all[i]->mapped, len);
+    size_t peak = mmaptwo_atomic_get(&all[i]->peak);
+    while (now > peak && !mmaptwo_atomic_cas(&all[i]->peak, peak, now)) {
+      peak = mmaptwo_atomic_get(&all[i]->peak);
+    }
+    if (fresh) {
+      mmaptwo_stat_add(&all[i]->maps, 1u);
+    }
+  }
+#else
+  (void)c;
+  (void)len;
+  (void)fresh;
+#endif /*MMAPTWO_STATS*/
+  return;
+}
+
+void mmaptwo_stat_unmap
+  (struct mmaptwo_counters* c, size_t len, int gone)
+{
+#if MMAPTWO_STATS
+  mmaptwo_stat_add(&c->mapped, (~len)+1u);
+  mmaptwo_stat_add(&mmaptwo_stats_global.mapped, (~len)+1u);
+  if (gone) {
+    mmaptwo_stat_add(&c->unmaps, 1u);
+    mmaptwo_stat_add(&mmaptwo_stats_global.unmaps, 1u);
+  }
+#else
+  (void)c;
+  (void)len;
+  (void)gone;
+#endif /*MMAPTWO_STATS*/
+  return;
+}
+#endif /*MMAPTWO_OS*/
+
+int mmaptwo_stat_read
+  (struct mmaptwo_counters* c, struct mmaptwo_stats* st, int reset)
+{
+#if MMAPTWO_STATS
+  size_t i;
+  st->acquires = mmaptwo_atomic_get(&c->acquires);
+  st->releases = mmaptwo_atomic_get(&c->releases);
+  st->failures = mmaptwo_atomic_get(&c->failures);
+  for (i = 0u; i < (size_t)mmaptwo_stats_errnos; ++i) {
+    st->errors[i] = mmaptwo_atomic_get(&c->errors[i]);
+  }
+  st->mapped = mmaptwo_atomic_get(&c->mapped);
+  st->peak = mmaptwo_atomic_get(&c->peak);
+  st->pages = mmaptwo_atomic_get(&c->pages);
+  st->maps = mmaptwo_atomic_get(&c->maps);
+  st->unmaps = mmaptwo_atomic_get(&c->unmaps);
+  if (reset) {
+    /* take away what was read, keeping anything counted since */
+    mmaptwo_stat_add(&c->acquires, (~st->acquires)+1u);
+    mmaptwo_stat_add(&c->releases, (~st->releases)+1u);
+    mmaptwo_stat_add(&c->failures, (~st->failures)+1u);
+    for (i = 0u; i < (size_t)mmaptwo_stats_errnos; ++i) {
+      mmaptwo_stat_add(&c->errors[i], (~st->errors[i])+1u);
+    }
+    mmaptwo_stat_add(&c->maps, (~st->maps)+1u);
+    mmaptwo_stat_add(&c->unmaps, (~st->unmaps)+1u);
+    mmaptwo_atomic_set(&c->peak, mmaptwo_atomic_get(&c->mapped));
+  }
+  return 0;
+#else
+  (void)c;
+  (void)st;
+  (void)reset;
+  return MMAPTWO_ENOSYS;
+#endif /*MMAPTWO_STATS*/
+}
+
+#if MMAPTWO_OS != MMAPTWO_OS_WIN32
 char* mmaptwo_wctomb(wchar_t const* nm) {
 #if (defined __STDC_VERSION__) && (__STDC_VERSION__ >= 199409L)
   /* use multibyte conversion */
   size_t ns;
-  char* out;
+  char* out;
+  /* try the length */{
+    mbstate_t mbs;
+    wchar_t const* test_nm = nm;
+    memset(&mbs, 0, sizeof(mbs));
+    ns = wcsrtombs(NULL, &test_nm, 0, &mbs);
+  }
+  if (ns == (size_t)(-1)
+  ||  ns == ~((size_t)0))
+  {
+    /* conversion error caused by bad sequence, so */return NULL;
+  }
+  out = calloc(ns+1, sizeof(char));
+  if (out) {
+    mbstate_t mbs;
+    wchar_t const* test_nm = nm;
+    memset(&mbs, 0, sizeof(mbs));
+    wcsrtombs(out, &test_nm, ns+1, &mbs);
+    out[ns] = 0;
+  }
+  return out;
+#else
+  /* no thread-safe version, so give up */
+  (void)nm;
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+#endif /*__STDC_VERSION__*/
+}
+#endif /*MMAPTWO_OS*/
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+int mmaptwo_mode_rw_cvt(int mmode) {
+#if (defined O_CLOEXEC)
+  int const fast_no_bequeath = (int)(O_CLOEXEC);
+#else
+  int const fast_no_bequeath = 0;
+#endif /*O_CLOEXEC*/
+  switch (mmode) {
+  case mmaptwo_mode_write:
+    return O_RDWR|fast_no_bequeath;
+  case mmaptwo_mode_read:
+    return O_RDONLY|fast_no_bequeath;
+  default:
+    return 0;
+  }
+}
+
+int mmaptwo_mode_prot_cvt(int mmode) {
+  switch (mmode) {
+  case mmaptwo_mode_write:
+    return PROT_WRITE|PROT_READ;
+  case mmaptwo_mode_read:
+    return PROT_READ;
+  default:
+    return 0;
+  }
+}
+
+int mmaptwo_mode_flag_cvt(int mprivy) {
+  return mprivy ? MAP_PRIVATE : MAP_SHARED;
+}
+
+int mmaptwo_mode_create_cvt(int mcreate) {
+  return mcreate ? O_CREAT : 0;
+}
+
+size_t mmaptwo_file_size_e(int fd) {
+  struct stat fsi;
+  memset(&fsi, 0, sizeof(fsi));
+  /* stat pull */{
+    int const res = fstat(fd, &fsi);
+    if (res != 0) {
+      return 0u;
+    } else return (size_t)(fsi.st_size);
+  }
+}
+
+struct mmaptwo_i* mmaptwo_open_rest
+  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+{
+  size_t const start = mmaptwo_clock_now();
+  struct mmaptwo_i* const out = mmaptwo_open_map(fd, mt, sz, off);
+  int const err = errno;
+  size_t const ns = mmaptwo_clock_since(start);
+  if (out != NULL) {
+    mmaptwo_latency_record(mmaptwo_latency_open, ns);
+  }
+  mmaptwo_trace_emit(MMAPTWO_TRACE_OPEN, out,
+    (out != NULL) ? mmaptwo_length(out) : sz, off, ns,
+    (out != NULL) ? 0 : err);
+  errno = err;
+  return out;
+}
+
+struct mmaptwo_i* mmaptwo_open_map
+  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+{
+  struct mmaptwo_unix *const out = calloc(1, sizeof(struct mmaptwo_unix));
+  if (out == NULL) {
+    close(fd);
+    return NULL;
+  }
+  /* assign the close-on-exec flag */{
+    int const old_flags = fcntl(fd, F_GETFD);
+    int bequeath_break = 0;
+    if (old_flags < 0) {
+      bequeath_break = 1;
+    } else if (mt.bequeath) {
+      bequeath_break = (fcntl(fd, F_SETFD, old_flags&(~FD_CLOEXEC)) < 0);
+    } else {
+      bequeath_break = (fcntl(fd, F_SETFD, old_flags|FD_CLOEXEC) < 0);
+    }
+    if (bequeath_break) {
+      close(fd);
+      free(out);
+      return NULL;
+    }
+  }
+  if (mt.end) /* fix map size */{
+    size_t const xsz = mmaptwo_file_size_e(fd);
+    if (xsz < off)
+      sz = 0 /*to fail*/;
+    else sz = xsz-off;
+  }
+  if (mt.create && !mt.end) /* preallocate the region */{
+    int const res = mmaptwo_file_reserve(fd, mt, sz, off);
+    if (res != 0) {
+      close(fd);
+      free(out);
+      errno = res;
+      return NULL;
+    } else if (mt.keep) {
+      /* start at the current end of file */
+      size_t const xsz = mmaptwo_file_size_e(fd);
+      if (xsz < off)
+        sz = 0u;
+      else if (xsz-off < sz)
+        sz = xsz-off;
+    }
+  }
+  if (sz == 0 && !(mt.create && mt.keep))/* then fail */ {
+    close(fd);
+    free(out);
+    errno = ERANGE;
+    return NULL;
+  }
+  if (mt.buffer) {
+    /* copy through reads and writes instead of mapping */
+    free(out);
+    return mmaptwo_buf_make(fd, mt, sz, off);
+  }
+#if MMAPTWO_URING
+  if (mt.uring && mt.mode != mmaptwo_mode_write) {
+    struct mmaptwo_i* const ur = mmaptwo_uring_make(fd, mt, sz, off);
+    if (ur != NULL) {
+      free(out);
+      return ur;
+    }
+    /* else fall back to mapping */
+  }
+#endif /*MMAPTWO_URING*/
+  /* prepare the page handle pool */{
+    size_t i;
+    size_t pool_size = mmaptwo_atomic_get(&mmaptwo_pool_default);
+    if (pool_size > MMAPTWO_POOL_MASK)
+      pool_size = MMAPTWO_POOL_MASK;
+    out->pool = pool_size
+      ? calloc(pool_size, sizeof(struct mmaptwo_page_unix))
+      : NULL;
+    out->pool_size = (out->pool != NULL) ? pool_size : 0u;
+    for (i = 0u; i < out->pool_size; ++i) {
+      out->pool[i].slot = i+1u;
+      out->pool[i].pool_next = (i+1u < out->pool_size) ? i+2u : 0u;
+    }
+    out->pool_head = out->pool_size ? 1u : 0u;
+  }
+  /* initialize the interface */{
+    out->len = sz;
+    out->fd = fd;
+    out->offnum = off;
+    out->mt = mt;
+    mmaptwo_align_init(out);
+    out->refs = 1u;
+    pthread_mutex_init(&out->grow_lock, NULL);
+    /* private writes must not leak into later pages */
+    out->cache_max = (mt.privy && mt.mode == mmaptwo_mode_write)
+      ? 0u : (size_t)(MMAPTWO_MAX_CACHE);
+    out->base.mmt_dtor = &mmaptwo_mmt_dtor;
+    out->base.mmt_acquire = &mmaptwo_mmt_acquire;
+    out->base.mmt_offset = &mmaptwo_mmt_offset;
+    out->base.mmt_length = &mmaptwo_mmt_length;
+    out->base.mmt_acquire_flags = &mmaptwo_mmt_acquire_flags;
+    out->base.mmt_pool_stats = &mmaptwo_mmt_pool_stats;
+    out->base.mmt_set_cache = &mmaptwo_mmt_set_cache;
+    out->base.mmt_cache_stats = &mmaptwo_mmt_cache_stats;
+    out->base.mmt_advise = &mmaptwo_mmt_advise;
+    out->base.mmt_locked = &mmaptwo_mmt_locked;
+    out->base.mmt_extend = &mmaptwo_mmt_extend;
+    out->base.mmt_acquire_batch = &mmaptwo_mmt_acquire_batch;
+    out->base.mmt_fd = &mmaptwo_mmt_fd;
+    out->base.mmt_set_prefetch = &mmaptwo_mmt_set_prefetch;
+    out->base.mmt_prefetch_stats = &mmaptwo_mmt_prefetch_stats;
+    out->base.mmt_residency = &mmaptwo_mmt_residency;
+    out->base.mmt_stats = &mmaptwo_mmt_stats;
+  }
+  if (mt.premap && sz > 0u && mmaptwo_premap(out) != 0) {
+    int const err = errno;
+    close(fd);
+    pthread_mutex_destroy(&out->grow_lock);
+    free(out->pool);
+    free(out);
+    errno = err;
+    return NULL;
+  }
+  return (struct mmaptwo_i*)out;
+}
+
+int mmaptwo_premap(struct mmaptwo_unix* mu) {
+  size_t const fullshift = mu->offnum%mu->align;
+  size_t fullsize;
+  void* ptr;
+  if (fullshift >= ((~(size_t)0u)-mu->len)) {
+    /* range fix failure */
+    errno = ERANGE;
+    return -1;
+  }
+  fullsize = mmaptwo_atomic_get(&mu->len)+fullshift;
+  ptr = mmaptwo_map(mu, &fullsize, mu->offnum-fullshift, 0);
+  if (ptr == MAP_FAILED) {
+    return -1;
+  }
+  mu->premap_ptr = ptr;
+  mu->premap_len = fullsize;
+  mu->premap_shift = fullshift;
+  return 0;
+}
+
+void mmaptwo_align_init(struct mmaptwo_unix* mu) {
+  long const psize = sysconf(_SC_PAGE_SIZE);
+  mu->align = (psize > 0) ? (size_t)psize : 1u;
+  mu->hugetlb = 0;
+  if (mu->mt.huge) {
+    size_t hsize = (size_t)(MMAPTWO_HUGE_PAGE);
+#if (defined __linux__)
+    struct statfs fsi;
+    if (fstatfs(mu->fd, &fsi) == 0
+    &&  (unsigned long)fsi.f_type == (unsigned long)HUGETLBFS_MAGIC
+    &&  fsi.f_bsize > 0)
+    {
+      mu->hugetlb = 1;
+      hsize = (size_t)fsi.f_bsize;
+    }
+#endif /*__linux__*/
+    if (hsize > mu->align)
+      mu->align = hsize;
+  }
+  return;
+}
+
+void* mmaptwo_map
+  (struct mmaptwo_unix* mu, size_t* len, size_t off, int flags)
+{
+  int const fd = mmaptwo_fd_hold(mu);
+  void* ptr;
+  if (fd == -1) {
+    return MAP_FAILED;
+  }
+  ptr = mmaptwo_map_fd(mu, fd, len, off, flags);
+  mmaptwo_fd_drop(mu);
+  return ptr;
+}
+
+void* mmaptwo_map_fd
+  (struct mmaptwo_unix* mu, int fd, size_t* len, size_t off, int flags)
+{
+  int const prot = mmaptwo_mode_prot_cvt(mu->mt.mode);
+  void* ptr = MAP_FAILED;
+  flags |= mmaptwo_mode_flag_cvt(mu->mt.privy);
+  if (!mu->mt.huge) {
+    ptr = mmap(NULL, *len, prot, flags, fd, (off_t)off);
+  } else if (mu->hugetlb) {
+    /* `hugetlbfs` maps whole huge pages only */
+    size_t const extra = *len % mu->align;
+    if (extra > 0u) {
+      if (mu->align-extra > (~(size_t)0u)-*len) {
+        errno = ERANGE;
+        return MAP_FAILED;
+      }
+      *len += mu->align-extra;
+    }
+#if (defined MAP_HUGETLB)
+    flags |= MAP_HUGETLB;
+#endif /*MAP_HUGETLB*/
+    ptr = mmap(NULL, *len, prot, flags, fd, (off_t)off);
+  } else {
+    /* align the address like the offset, so that huge pages can fit */
+    if (mu->align <= (~(size_t)0u)-*len) {
+      size_t const span = *len+mu->align;
+      unsigned char* const res = (unsigned char*)mmap(NULL, span,
+          PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      if ((void*)res != MAP_FAILED) {
+        size_t const lead =
+          (mu->align - ((size_t)res)%mu->align) % mu->align;
+        ptr = mmap(res+lead, *len, prot, flags|MAP_FIXED,
+            fd, (off_t)off);
+        if (ptr == MAP_FAILED) {
+          int const err = errno;
+          munmap(res, span);
+          errno = err;
+          return MAP_FAILED;
+        }
+        if (lead > 0u) {
+          munmap(res, lead);
+        }
+        /* release the reservation past the mapping's last page */{
+          long const psize = sysconf(_SC_PAGE_SIZE);
+          size_t end = lead+*len;
+          if (psize > 0 && end%((unsigned long)psize) > 0u)
+            end += (unsigned long)psize - end%((unsigned long)psize);
+          if (end < span) {
+            munmap(res+end, span-end);
+          }
+        }
+      }
+    }
+    if (ptr == MAP_FAILED) {
+      ptr = mmap(NULL, *len, prot, flags, fd, (off_t)off);
+    }
+#if (defined MADV_HUGEPAGE)
+    if (ptr != MAP_FAILED) {
+      madvise(ptr, *len, MADV_HUGEPAGE);
+    }
+#endif /*MADV_HUGEPAGE*/
+  }
+  if (ptr != MAP_FAILED && mu->mt.lock) {
+    /* lock for the lifetime of the mapping */
+    if (mlock(ptr, *len) != 0) {
+      int const err = errno;
+      munmap(ptr, *len);
+      errno = err;
+      return MAP_FAILED;
+    }
+    mmaptwo_atomic_add(&mu->locked, *len);
+  }
+  if (ptr != MAP_FAILED) {
+    mmaptwo_stat_map(&mu->stats, *len, 1);
+  }
+  return ptr;
+}
+
+void mmaptwo_unmap(struct mmaptwo_unix* mu, void* ptr, size_t len) {
+  munmap(ptr, len);
+  mmaptwo_stat_unmap(&mu->stats, len, 1);
+  if (mu->mt.lock) {
+    mmaptwo_atomic_add(&mu->locked, (~len)+1u);
+  }
+  return;
+}
+
+size_t mmaptwo_mmt_locked(struct mmaptwo_i const* m) {
+  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
+  return mmaptwo_atomic_get(&mu->locked);
+}
+
+int mmaptwo_mmtp_lock(struct mmaptwo_page_i* p, int onfault) {
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  struct mmaptwo_unix* const mu = pu->src;
+  size_t lead = pu->shift;
+  int res;
+  if (mu->mt.lock || pu->locked > 0u) {
+    /* already locked */
+    return 0;
+  }
+  /* align the start of the range to a page, as `ptr` already is */{
+    long const psize = sysconf(_SC_PAGE_SIZE);
+    if (psize > 0) {
+      lead -= lead%((unsigned long)psize);
+    }
+  }
+#if (defined MLOCK_ONFAULT)
+  if (onfault) {
+    res = mlock2((unsigned char*)pu->ptr+lead, pu->len-lead, MLOCK_ONFAULT);
+  } else
+#endif /*MLOCK_ONFAULT*/
+  res = mlock((unsigned char*)pu->ptr+lead, pu->len-lead);
+  if (res != 0) {
+    return errno;
+  }
+  pu->locked = pu->len-lead;
+  pu->lock_onfault = onfault;
+  mmaptwo_atomic_add(&mu->locked, pu->locked);
+  return 0;
+}
+
+int mmaptwo_mmtp_flush
+  (struct mmaptwo_page_i* p, size_t sz, size_t off, int flags)
+{
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  size_t const start = mmaptwo_clock_now();
+  int const res = mmaptwo_mmtp_sync(p, sz, off, flags);
+  size_t const ns = mmaptwo_clock_since(start);
+  mmaptwo_latency_record(mmaptwo_latency_flush, ns);
+  mmaptwo_trace_emit(MMAPTWO_TRACE_FLUSH, (struct mmaptwo_i*)pu->src,
+    sz, pu->offnum+off, ns, res);
+  return res;
+}
+
+int mmaptwo_mmtp_sync
+  (struct mmaptwo_page_i* p, size_t sz, size_t off, int flags)
+{
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  struct mmaptwo_unix* const mu = pu->src;
+  size_t lead;
+  if (off > pu->len-pu->shift || sz > pu->len-pu->shift-off) {
+    return EDOM;
+  }
+  if ((flags & mmaptwo_flush_data) && (flags & mmaptwo_flush_invalidate)) {
+    /* the data path never touches the mappings */
+    return EINVAL;
+  }
+  if (sz == 0u || mu->mt.privy || mu->mt.mode != mmaptwo_mode_write) {
+    /* nothing can reach the file */
+    return 0;
+  }
+  if (flags & mmaptwo_flush_data) {
+    /* skip the mapping, and push the file's data directly */
+    int const fd = mmaptwo_fd_hold(mu);
+    int res;
+    if (fd == -1) {
+      return errno;
+    }
+#if (defined SYNC_FILE_RANGE_WRITE)
+    /* start writing only the range */
+    res = sync_file_range(fd, (off_t)(mu->offnum+pu->offnum+off),
+        (off_t)sz, SYNC_FILE_RANGE_WRITE) != 0 ? errno : 0;
+    if (res == 0 && !(flags & mmaptwo_flush_async)) {
+      /* the range alone leaves device caches and metadata behind */
+      res = fdatasync(fd) != 0 ? errno : 0;
+    }
+#else
+    res = fdatasync(fd) != 0 ? errno : 0;
+#endif /*SYNC_FILE_RANGE_WRITE*/
+    mmaptwo_fd_drop(mu);
+    return res;
+  }
+  lead = pu->shift+off;
+  /* align the start of the range to a page, as `ptr` already is */{
+    long const psize = sysconf(_SC_PAGE_SIZE);
+    if (psize > 0) {
+      lead -= lead%((unsigned long)psize);
+    }
+  }
+  return msync((unsigned char*)pu->ptr+lead, pu->shift+off+sz-lead,
+      ((flags & mmaptwo_flush_async) ? MS_ASYNC : MS_SYNC)
+      | ((flags & mmaptwo_flush_invalidate) ? MS_INVALIDATE : 0)) != 0
+    ? errno : 0;
+}
+
+int mmaptwo_mmtp_resize(struct mmaptwo_page_i* p, size_t sz) {
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  struct mmaptwo_unix* const mu = pu->src;
+  size_t const len = mmaptwo_atomic_get(&mu->len);
+  size_t room;
+  int const relock = (pu->locked > 0u);
+  int res = 0;
+  if (sz == 0u || pu->offnum > len || sz > len-pu->offnum
+  ||  pu->shift >= (~(size_t)0u)-sz)
+  {
+    return EDOM;
+  }
+  if (pu->borrow)
+    room = mu->premap_len;
+  else if (pu->view != NULL)
+    room = pu->view->len;
+  else room = pu->maplen;
+  if (pu->shift+sz <= room) {
+    /* the mapping already covers the new length */
+    if (relock)
+      mmaptwo_mmtp_unlock(p);
+    pu->len = pu->shift+sz;
+    return relock ? mmaptwo_mmtp_lock(p, pu->lock_onfault) : 0;
+  }
+  if (relock)
+    mmaptwo_mmtp_unlock(p);
+#if (defined MREMAP_MAYMOVE)
+  if (!pu->borrow && pu->view == NULL) {
+    /* grow in place, or move while keeping resident pages */
+    size_t mapsize = pu->shift+sz;
+    void* ptr;
+    if (mu->hugetlb && mapsize%mu->align > 0u) {
+      if (mu->align-mapsize%mu->align > (~(size_t)0u)-mapsize)
+        res = ERANGE;
+      else mapsize += mu->align-mapsize%mu->align;
+    }
+    if (res != 0) {
+      /* keep the old mapping; relock it below */
+    } else if ((ptr = mremap(pu->ptr, pu->maplen, mapsize, MREMAP_MAYMOVE))
+        == MAP_FAILED)
+    {
+      res = errno;
+    } else {
+      if (mu->mt.lock) {
+        mmaptwo_atomic_add(&mu->locked, mapsize-pu->maplen);
+      }
+      if (mapsize >= pu->maplen)
+        mmaptwo_stat_map(&mu->stats, mapsize-pu->maplen, 0);
+      else mmaptwo_stat_unmap(&mu->stats, pu->maplen-mapsize, 0);
+      pu->ptr = ptr;
+      pu->maplen = mapsize;
+      pu->len = pu->shift+sz;
+    }
+  } else
+#endif /*MREMAP_MAYMOVE*/
+  {
+    /* make a new mapping, then let go of the old one */
+    size_t const off = mu->offnum+pu->offnum;
+    size_t const fullshift = off%mu->align;
+    size_t mapsize = fullshift+sz;
+    void* const ptr = (fullshift >= (~(size_t)0u)-sz)
+      ? MAP_FAILED
+      : mmaptwo_map(mu, &mapsize, off-fullshift, 0);
+    if (ptr == MAP_FAILED) {
+      res = errno;
+    } else {
+      if (pu->view != NULL) {
+        struct mmaptwo_view_unix* const v = pu->view;
+        if (mmaptwo_view_release(mu, v)) {
+          mmaptwo_unmap(mu, v->ptr, v->len);
+          free(v);
+        }
+      } else if (!pu->borrow) {
+        mmaptwo_unmap(mu, pu->ptr, pu->maplen);
+      }
+      pu->ptr = ptr;
+      pu->maplen = mapsize;
+      pu->mapoff = off-fullshift;
+      pu->shift = fullshift;
+      pu->len = fullshift+sz;
+      pu->borrow = 0;
+      pu->view = NULL;
+    }
+  }
+  if (relock) {
+    int const lock_res = mmaptwo_mmtp_lock(p, pu->lock_onfault);
+    if (res == 0)
+      res = lock_res;
+  }
+  return res;
+}
+
+int mmaptwo_mincore
+  ( void* ptr, size_t lead, size_t sz, unsigned char* bits,
+    size_t* resident)
+{
+  unsigned char vec[256];
+  size_t const psize = (size_t)sysconf(_SC_PAGE_SIZE);
+  size_t const first = lead/psize;
+  size_t const last = (sz > 0u) ? (lead+sz-1u)/psize : first;
+  size_t count = 0u;
+  size_t i;
+  if (bits != NULL) {
+    memset(bits, 0, (last-first)/8u+1u);
+  }
+  for (i = first; i <= last && sz > 0u; ) {
+    /* query a window of pages at a time */
+    size_t const n = (last+1u-i < sizeof(vec)) ? last+1u-i : sizeof(vec);
+    size_t j;
+    if (mincore((unsigned char*)ptr+i*psize, n*psize, (void*)vec) != 0) {
+      return errno;
+    }
+    for (j = 0u; j < n; ++j, ++i) {
+      size_t lo;
+      size_t hi;
+      if (!(vec[j] & 1u))
+        continue;
+      if (bits != NULL)
+        bits[(i-first)/8u] |= (unsigned char)(1u << ((i-first)%8u));
+      lo = (i*psize > lead) ? i*psize : lead;
+      hi = ((i+1u)*psize < lead+sz) ? (i+1u)*psize : lead+sz;
+      count += hi-lo;
+    }
+  }
+  if (resident != NULL)
+    *resident = count;
+  return 0;
+}
+
+int mmaptwo_file_residency
+  ( int fd, size_t off, size_t sz, unsigned char* bits,
+    size_t* resident)
+{
+  size_t const psize = (size_t)sysconf(_SC_PAGE_SIZE);
+  size_t const lead = off%psize;
+  void* ptr;
+  int res;
+  if (sz == 0u) {
+    return mmaptwo_mincore(NULL, 0u, 0u, bits, resident);
+  }
+  /* a fresh mapping faults nothing in, so `mincore` sees the cache */
+  ptr = mmap(NULL, lead+sz, PROT_READ, MAP_SHARED, fd, (off_t)(off-lead));
+  if (ptr == MAP_FAILED) {
+    return errno;
+  }
+  res = mmaptwo_mincore(ptr, lead, sz, bits, resident);
+  munmap(ptr, lead+sz);
+  return res;
+}
+
+int mmaptwo_mmt_residency
+  ( struct mmaptwo_i* m, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident)
+{
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  int fd;
+  int res;
+  if (off > mmaptwo_atomic_get(&mu->len)
+  ||  sz > mmaptwo_atomic_get(&mu->len)-off)
+  {
+    return EDOM;
+  }
+  if (mu->premap_ptr != NULL
+  &&  off+sz <= mu->premap_len-mu->premap_shift)
+  {
+    /* the whole-source mapping already covers the range */
+    return mmaptwo_mincore
+      (mu->premap_ptr, mu->premap_shift+off, sz, bits, resident);
+  }
+  fd = mmaptwo_fd_hold(mu);
+  if (fd == -1) {
+    return errno;
+  }
+  res = mmaptwo_file_residency(fd, mu->offnum+off, sz, bits, resident);
+  mmaptwo_fd_drop(mu);
+  return res;
+}
+
+int mmaptwo_file_resident(int fd, size_t off, size_t sz) {
+  size_t resident;
+  int const res = mmaptwo_file_residency(fd, off, sz, NULL, &resident);
+  if (res != 0) {
+    return res;
+  } else if (resident < sz) {
+    posix_fadvise(fd, (off_t)off, (off_t)sz, POSIX_FADV_WILLNEED);
+    return MMAPTWO_EWOULDBLOCK;
+  }
+  return 0;
+}
+
+int mmaptwo_mmtp_residency
+  ( struct mmaptwo_page_i* p, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident)
+{
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  if (off > pu->len-pu->shift || sz > pu->len-pu->shift-off) {
+    return EDOM;
+  }
+  return mmaptwo_mincore(pu->ptr, pu->shift+off, sz, bits, resident);
+}
+
+int mmaptwo_mmtp_unlock(struct mmaptwo_page_i* p) {
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  struct mmaptwo_unix* const mu = pu->src;
+  if (pu->locked == 0u) {
+    return 0;
+  }
+  if (munlock((unsigned char*)pu->ptr+(pu->len-pu->locked), pu->locked)
+      != 0)
+  {
+    return errno;
+  }
+  mmaptwo_atomic_add(&mu->locked, (~pu->locked)+1u);
+  pu->locked = 0u;
+  return 0;
+}
+
+void mmaptwo_unix_release(struct mmaptwo_unix* mu) {
+  if (mmaptwo_atomic_add(&mu->refs, ~(size_t)0u) == 0u) {
+    if (mu->premap_ptr != NULL) {
+      mmaptwo_unmap(mu, mu->premap_ptr, mu->premap_len);
+      mu->premap_ptr = NULL;
+    }
+    free(mu->pool);
+    if (mu->dir != NULL) {
+      mmaptwo_dir_release(mu->dir);
+      free(mu->name);
+    }
+    pthread_mutex_destroy(&mu->grow_lock);
+    free(mu);
+  }
+  return;
+}
+
+struct mmaptwo_page_unix* mmaptwo_pool_take(struct mmaptwo_unix* mu) {
+  struct mmaptwo_page_unix* out;
+  for (;;) {
+    size_t const head = mmaptwo_atomic_get(&mu->pool_head);
+    size_t const slot = head&MMAPTWO_POOL_MASK;
+    size_t next;
+    if (slot == 0u) {
+      break;
+    }
+    out = mu->pool+(slot-1u);
+    next = mmaptwo_atomic_get(&out->pool_next);
+    /* bump the tag, so that stale heads fail to compare */
+    if (mmaptwo_atomic_cas(&mu->pool_head, head,
+        ((head&~MMAPTWO_POOL_MASK)+MMAPTWO_POOL_MASK+1u)|next))
+    {
+      mmaptwo_atomic_add(&mu->pool_hits, 1u);
+      return out;
+    }
+  }
+  mmaptwo_atomic_add(&mu->pool_misses, 1u);
+  return calloc(1,sizeof(struct mmaptwo_page_unix));
+}
+
+void mmaptwo_pool_give
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu)
+{
+  if (pu->slot == 0u) {
+    free(pu);
+    return;
+  }
+  for (;;) {
+    size_t const head = mmaptwo_atomic_get(&mu->pool_head);
+    mmaptwo_atomic_set(&pu->pool_next, head&MMAPTWO_POOL_MASK);
+    if (mmaptwo_atomic_cas(&mu->pool_head, head,
+        ((head&~MMAPTWO_POOL_MASK)+MMAPTWO_POOL_MASK+1u)|pu->slot))
+    {
+      return;
+    }
+  }
+}
+
+int mmaptwo_mmt_pool_stats
+  (struct mmaptwo_i const* m, size_t* hits, size_t* misses)
+{
+  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
+  if (hits != NULL)
+    *hits = mmaptwo_atomic_get(&mu->pool_hits);
+  if (misses != NULL)
+    *misses = mmaptwo_atomic_get(&mu->pool_misses);
+  return 0;
+}
+
+struct mmaptwo_page_unix* mmaptwo_cache_take
+  (struct mmaptwo_unix* mu, size_t sz, size_t off)
+{
+  struct mmaptwo_page_unix* pu;
+  mmaptwo_spin_lock(&mu->cache_lock);
+  for (pu = mu->cache_head; pu != NULL; pu = pu->lru_next) {
+    if (pu->mapoff <= off
+    &&  off-pu->mapoff <= pu->maplen
+    &&  sz <= pu->maplen-(off-pu->mapoff))
+    {
+      break;
+    }
+  }
+  if (pu != NULL) {
+    if (pu->lru_prev != NULL)
+      pu->lru_prev->lru_next = pu->lru_next;
+    else mu->cache_head = pu->lru_next;
+    if (pu->lru_next != NULL)
+      pu->lru_next->lru_prev = pu->lru_prev;
+    else mu->cache_tail = pu->lru_prev;
+    pu->lru_prev = NULL;
+    pu->lru_next = NULL;
+    mu->cache_bytes -= pu->maplen;
+    mu->cache_hits += 1u;
+  } else if (mu->cache_max > 0u) {
+    mu->cache_misses += 1u;
+  }
+  mmaptwo_spin_unlock(&mu->cache_lock);
+  return pu;
+}
+
+int mmaptwo_cache_give
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu)
+{
+  struct mmaptwo_page_unix* dropped;
+  mmaptwo_spin_lock(&mu->cache_lock);
+  if (mu->closed || pu->maplen > mu->cache_max) {
+    mmaptwo_spin_unlock(&mu->cache_lock);
+    return 0;
+  }
+  dropped = mmaptwo_cache_trim(mu, mu->cache_max-pu->maplen);
+  pu->lru_prev = NULL;
+  pu->lru_next = mu->cache_head;
+  if (mu->cache_head != NULL)
+    mu->cache_head->lru_prev = pu;
+  else mu->cache_tail = pu;
+  mu->cache_head = pu;
+  mu->cache_bytes += pu->maplen;
+  mmaptwo_spin_unlock(&mu->cache_lock);
+  mmaptwo_cache_drop(mu, dropped);
+  return 1;
+}
+
+struct mmaptwo_page_unix* mmaptwo_cache_trim
+  (struct mmaptwo_unix* mu, size_t max)
+{
+  struct mmaptwo_page_unix* out = NULL;
+  while (mu->cache_bytes > max) {
+    struct mmaptwo_page_unix* const pu = mu->cache_tail;
+    mu->cache_tail = pu->lru_prev;
+    if (mu->cache_tail != NULL)
+      mu->cache_tail->lru_next = NULL;
+    else mu->cache_head = NULL;
+    mu->cache_bytes -= pu->maplen;
+    mu->cache_evictions += 1u;
+    pu->lru_prev = NULL;
+    pu->lru_next = out;
+    out = pu;
+  }
+  return out;
+}
+
+void mmaptwo_cache_drop
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu)
+{
+  while (pu != NULL) {
+    struct mmaptwo_page_unix* const next = pu->lru_next;
+    mmaptwo_unmap(mu, pu->ptr, pu->maplen);
+    pu->ptr = NULL;
+    pu->lru_next = NULL;
+    mmaptwo_pool_give(mu, pu);
+    pu = next;
+  }
+  return;
+}
+
+int mmaptwo_mmt_set_cache(struct mmaptwo_i* m, size_t max) {
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  struct mmaptwo_page_unix* dropped;
+  if (max > 0u && mu->mt.privy && mu->mt.mode == mmaptwo_mode_write) {
+    /* private writes must not leak into later pages */
+    return EINVAL;
+  }
+  mmaptwo_spin_lock(&mu->cache_lock);
+  mu->cache_max = max;
+  dropped = mmaptwo_cache_trim(mu, max);
+  mmaptwo_spin_unlock(&mu->cache_lock);
+  mmaptwo_cache_drop(mu, dropped);
+  return 0;
+}
+
+int mmaptwo_mmt_cache_stats
+  (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st)
+{
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  mmaptwo_spin_lock(&mu->cache_lock);
+  st->hits = mu->cache_hits;
+  st->misses = mu->cache_misses;
+  st->evictions = mu->cache_evictions;
+  st->bytes = mu->cache_bytes;
+  st->max = mu->cache_max;
+  mmaptwo_spin_unlock(&mu->cache_lock);
+  return 0;
+}
+
+struct mmaptwo_view_unix* mmaptwo_view_find
+  (struct mmaptwo_unix* mu, size_t sz, size_t off)
+{
+  struct mmaptwo_view_unix* v;
+  mmaptwo_spin_lock(&mu->view_lock);
+  for (v = mu->views; v != NULL && v->off <= off; v = v->next) {
+    if (off-v->off <= v->len && sz <= v->len-(off-v->off)) {
+      v->refs += 1u;
+      break;
+    }
+  }
+  if (v != NULL && v->off > off)
+    v = NULL;
+  mmaptwo_spin_unlock(&mu->view_lock);
+  return v;
+}
+
+struct mmaptwo_view_unix* mmaptwo_view_add
+  (struct mmaptwo_unix* mu, void* ptr, size_t len, size_t off, size_t refs)
+{
+  struct mmaptwo_view_unix* const out =
+    calloc(1, sizeof(struct mmaptwo_view_unix));
+  if (out == NULL) {
+    return NULL;
+  }
+  out->ptr = ptr;
+  out->len = len;
+  out->off = off;
+  out->refs = refs;
+  mmaptwo_spin_lock(&mu->view_lock);
+  /* insert in order of file offset */{
+    struct mmaptwo_view_unix* prev = NULL;
+    struct mmaptwo_view_unix* next = mu->views;
+    while (next != NULL && next->off < off) {
+      prev = next;
+      next = next->next;
+    }
+    out->prev = prev;
+    out->next = next;
+    if (prev != NULL)
+      prev->next = out;
+    else mu->views = out;
+    if (next != NULL)
+      next->prev = out;
+  }
+  mmaptwo_spin_unlock(&mu->view_lock);
+  return out;
+}
+
+int mmaptwo_view_release
+  (struct mmaptwo_unix* mu, struct mmaptwo_view_unix* v)
+{
+  int last;
+  mmaptwo_spin_lock(&mu->view_lock);
+  v->refs -= 1u;
+  last = (v->refs == 0u);
+  if (last) {
+    if (v->prev != NULL)
+      v->prev->next = v->next;
+    else mu->views = v->next;
+    if (v->next != NULL)
+      v->next->prev = v->prev;
+  }
+  mmaptwo_spin_unlock(&mu->view_lock);
+  return last;
+}
+
+void mmaptwo_mmt_dtor(struct mmaptwo_i* m) {
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  struct mmaptwo_page_unix* dropped;
+  if (mu->grown > 0u) {
+    /* give back the growth that no one asked for */
+    int const fd = mmaptwo_fd_hold(mu);
+    if (fd != -1) {
+      size_t const end = mu->offnum+mmaptwo_atomic_get(&mu->len);
+      if (mmaptwo_file_size_e(fd) == mu->grown && end < mu->grown
+      &&  ftruncate(fd, (off_t)end) != 0)
+      {
+        /* the destructor has no way to report failure */;
+      }
+      mmaptwo_fd_drop(mu);
+    }
+  }
+  mmaptwo_spin_lock(&mu->cache_lock);
+  mu->closed = 1;
+  dropped = mmaptwo_cache_trim(mu, 0u);
+  mmaptwo_spin_unlock(&mu->cache_lock);
+  mmaptwo_cache_drop(mu, dropped);
+  if (mmaptwo_atomic_get(&mu->pf_used)) {
+    mmaptwo_prefetch_detach(mu);
+  }
+  if (mu->dir != NULL) {
+    /* leave the directory's descriptor list */
+    struct mmaptwo_dir* const d = mu->dir;
+    int fd;
+    mmaptwo_spin_lock(&d->lock);
+    if (mu->fd_prev != NULL)
+      mu->fd_prev->fd_next = mu->fd_next;
+    else d->lru_head = mu->fd_next;
+    if (mu->fd_next != NULL)
+      mu->fd_next->fd_prev = mu->fd_prev;
+    else d->lru_tail = mu->fd_prev;
+    mu->fd_prev = NULL;
+    mu->fd_next = NULL;
+    fd = mu->fd;
+    if (fd != -1)
+      d->fds -= 1u;
+    mu->fd = -1;
+    mmaptwo_spin_unlock(&d->lock);
+    if (fd != -1)
+      close(fd);
+  } else {
+    close(mu->fd);
+    mu->fd = -1;
+  }
+  mmaptwo_unix_release(mu);
+  return;
+}
+
+void mmaptwo_mmtp_dtor(struct mmaptwo_page_i* p) {
+  size_t const start = mmaptwo_clock_now();
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  struct mmaptwo_unix* const mu = pu->src;
+  size_t const siz = pu->len-pu->shift;
+  size_t const off = pu->offnum;
+  int owned = !pu->borrow;
+  size_t ns;
+  mmaptwo_mmtp_unlock(p);
+  mmaptwo_stat_release(&mu->stats);
+  pu->src = NULL;
+  if (pu->view != NULL) {
+    struct mmaptwo_view_unix* const v = pu->view;
+    pu->view = NULL;
+    owned = mmaptwo_view_release(mu, v);
+    if (owned) {
+      /* the page handle takes over the mapping */
+      pu->ptr = v->ptr;
+      pu->maplen = v->len;
+      pu->mapoff = v->off;
+      free(v);
+    }
+  }
+  if (!owned || !mmaptwo_cache_give(mu, pu)) {
+    if (owned) {
+      mmaptwo_unmap(mu, pu->ptr, pu->maplen);
+    }
+    pu->ptr = NULL;
+    mmaptwo_pool_give(mu, pu);
+  }
+  /* report while the instance is sure to be open */
+  ns = mmaptwo_clock_since(start);
+  mmaptwo_latency_record(mmaptwo_latency_release, ns);
+  mmaptwo_trace_emit(MMAPTWO_TRACE_PAGE_CLOSE, (struct mmaptwo_i*)mu,
+    siz, off, ns, 0);
+  mmaptwo_unix_release(mu);
+  return;
+}
+
+void* mmaptwo_mmtp_get(struct mmaptwo_page_i* p) {
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  return ((unsigned char*)pu->ptr)+pu->shift;
+}
+void const* mmaptwo_mmtp_getconst(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_page_unix const* const pu =
+    (struct mmaptwo_page_unix const*)p;
+  return ((unsigned char const*)pu->ptr)+pu->shift;
+}
+
+struct mmaptwo_page_i* mmaptwo_mmt_acquire
+  (struct mmaptwo_i* m, size_t sz, size_t pre_off)
+{
+  return mmaptwo_mmt_acquire_flags(m, sz, pre_off, 0);
+}
+
+void mmaptwo_populate
+  (struct mmaptwo_unix* mu, struct mmaptwo_page_unix* pu)
+{
+  long const psize = sysconf(_SC_PAGE_SIZE);
+  unsigned long const step = (psize > 0) ? (unsigned long)psize : 4096u;
+  size_t const lead = pu->shift - pu->shift%step;
+#if (defined MADV_POPULATE_READ) && (defined MADV_POPULATE_WRITE)
+  /* prefer a single system call */{
+    int const flag = (mu->mt.mode == mmaptwo_mode_write && !mu->mt.privy)
+      ? MADV_POPULATE_WRITE : MADV_POPULATE_READ;
+    if (madvise((unsigned char*)pu->ptr+lead, pu->len-lead, flag) == 0
+    ||  errno != EINVAL)
+    {
+      return;
+    }
+  }
+#endif /*MADV_POPULATE_READ*/
+  /* touch each page, stopping at end of file to avoid `SIGBUS` */{
+    unsigned char const volatile* const base =
+      (unsigned char const volatile*)pu->ptr;
+    int const fd = mmaptwo_fd_hold(mu);
+    size_t const fsz = (fd != -1) ? mmaptwo_file_size_e(fd) : 0u;
+    size_t const mapoff = pu->offnum+mu->offnum-pu->shift;
+    size_t end = pu->len;
+    size_t i;
+    unsigned char sink = 0u;
+    if (fd != -1)
+      mmaptwo_fd_drop(mu);
+    if (fsz <= mapoff)
+      end = 0u;
+    else if (fsz-mapoff < end)
+      end = fsz-mapoff;
+    for (i = lead; i < end; i += step) {
+      sink ^= base[i];
+    }
+    (void)sink;
+  }
+  return;
+}
+
+struct mmaptwo_page_i* mmaptwo_mmt_acquire_flags
+  (struct mmaptwo_i* m, size_t sz, size_t pre_off, int flags)
+{
+  size_t start;
+  struct mmaptwo_page_i* out;
+  int err;
+  size_t ns;
+  mmaptwo_trace_emit(MMAPTWO_TRACE_ACQUIRE_BEGIN, m, sz, pre_off, 0u, 0);
+  start = mmaptwo_clock_now();
+  out = mmaptwo_mmt_acquire_page(m, sz, pre_off, flags, NULL);
+  err = errno;
+  if (out == NULL) {
+    mmaptwo_stat_fail(&((struct mmaptwo_unix*)m)->stats, err);
+  }
+  ns = mmaptwo_clock_since(start);
+  mmaptwo_latency_record(mmaptwo_latency_acquire, ns);
+  mmaptwo_trace_emit(MMAPTWO_TRACE_ACQUIRE_END, m, sz, pre_off, ns,
+    (out != NULL) ? 0 : err);
+  errno = err;
+  return out;
+}
+
+struct mmaptwo_page_i* mmaptwo_mmt_acquire_page
+  (struct mmaptwo_i* m, size_t sz, size_t pre_off, int flags, int* mapped)
+{
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  int populate = mu->mt.populate || (flags & mmaptwo_acquire_populate);
+  size_t off;
+  struct mmaptwo_page_unix* out;
+  size_t fullsize;
+  size_t fullshift;
+  void *ptr;
+  struct mmaptwo_view_unix* view;
+  if (mapped != NULL)
+    *mapped = 0;
+  /* repair input size and offset */{
+    size_t const len = mmaptwo_atomic_get(&mu->len);
+    if (pre_off > len
+    ||  sz > len - pre_off
+    ||  sz == 0u)
+    {
+      errno = EDOM;
+      return NULL;
+    }
+    off = pre_off + mu->offnum;
+  }
+  if (mmaptwo_atomic_get(&mu->pf_on)) {
+    mmaptwo_prefetch_note(mu, pre_off, sz);
+  }
+  if (flags & mmaptwo_acquire_resident) {
+    int const res = mmaptwo_mmt_resident(mu, pre_off, sz);
+    if (res != 0) {
+      errno = res;
+      return NULL;
+    }
+  }
+  if (mu->premap_ptr != NULL
+  &&  pre_off+sz <= mu->premap_len-mu->premap_shift)
+  {
+    /* hand out a view into the whole-source mapping */
+    out = mmaptwo_pool_take(mu);
+    if (out == NULL) {
+      /* give up, and */return NULL;
+    }
+    ptr = mu->premap_ptr;
+    fullshift = mu->premap_shift+pre_off;
+    fullsize = fullshift+sz;
+    out->borrow = 1;
+    out->view = NULL;
+  } else if (mu->mt.share && (view = mmaptwo_view_find(mu, sz, off)) != NULL)
+  {
+    /* share a live mapping */
+    out = mmaptwo_pool_take(mu);
+    if (out == NULL) {
+      if (mmaptwo_view_release(mu, view)) {
+        mmaptwo_unmap(mu, view->ptr, view->len);
+        free(view);
+      }
+      /* give up, and */return NULL;
+    }
+    ptr = view->ptr;
+    fullshift = off-view->off;
+    fullsize = fullshift+sz;
+    out->borrow = 0;
+    out->view = view;
+  } else if ((out = mmaptwo_cache_take(mu, sz, off)) != NULL) {
+    /* reuse a recently released mapping */
+    ptr = out->ptr;
+    fullshift = off-out->mapoff;
+    fullsize = fullshift+sz;
+    out->view = mu->mt.share
+      ? mmaptwo_view_add(mu, ptr, out->maplen, out->mapoff, 1u)
+      : NULL;
+  } else {
+    size_t mapsize;
+    size_t mapoff;
+    out = mmaptwo_pool_take(mu);
+    if (out == NULL) {
+      /* give up, and */return NULL;
+    }
+    /* fix to page sizes */{
+      fullsize = sz;
+      /* adjust the offset */
+      fullshift = off%mu->align;
+      if (fullshift >= ((~(size_t)0u)-sz)) {
+        /* range fix failure */
+        mmaptwo_pool_give(mu, out);
+        errno = ERANGE;
+        return NULL;
+      } else fullsize += fullshift;
+    }
+    mapsize = fullsize;
+    mapoff = off-fullshift;
+#if (defined MAP_POPULATE)
+    /* transparent huge pages need their advice before faulting */
+    if (populate && (!mu->mt.huge || mu->hugetlb)) {
+      ptr = mmaptwo_map(mu, &mapsize, mapoff, MAP_POPULATE);
+      populate = 0;
+    } else
+#endif /*MAP_POPULATE*/
+    ptr = mmaptwo_map(mu, &mapsize, mapoff, 0);
+    if (ptr == MAP_FAILED) {
+      mmaptwo_pool_give(mu, out);
+      return NULL;
+    }
+    if (mapped != NULL)
+      *mapped = 1;
+    out->borrow = 0;
+    out->maplen = mapsize;
+    out->mapoff = mapoff;
+    /* apply the instance's advice */{
+      int const advice = (int)mmaptwo_atomic_get(&mu->advice);
+      if (advice != mmaptwo_advice_normal) {
+        mmaptwo_madvise(ptr, mapsize, advice);
+      }
+    }
+    out->view = mu->mt.share
+      ? mmaptwo_view_add(mu, ptr, mapsize, mapoff, 1u)
+      : NULL;
+  }
+  mmaptwo_page_init(mu, out, ptr, fullshift, sz, pre_off);
+  if (populate) {
+    mmaptwo_populate(mu, out);
+  }
+  return (struct mmaptwo_page_i*)out;
+}
+
+void mmaptwo_page_init
+  ( struct mmaptwo_unix* mu, struct mmaptwo_page_unix* out, void* ptr,
+    size_t fullshift, size_t sz, size_t pre_off)
+{
+  mmaptwo_atomic_add(&mu->refs, 1u);
+  mmaptwo_stat_acquire(&mu->stats);
+  out->ptr = ptr;
+  out->len = fullshift+sz;
+  out->shift = fullshift;
+  out->offnum = pre_off;
+  out->src = mu;
+  out->base.mmtp_dtor = &mmaptwo_mmtp_dtor;
+  out->base.mmtp_get = &mmaptwo_mmtp_get;
+  out->base.mmtp_getconst = &mmaptwo_mmtp_getconst;
+  out->base.mmtp_offset = &mmaptwo_mmtp_offset;
+  out->base.mmtp_length = &mmaptwo_mmtp_length;
+  out->base.mmtp_advise = &mmaptwo_mmtp_advise;
+  out->base.mmtp_lock = &mmaptwo_mmtp_lock;
+  out->base.mmtp_unlock = &mmaptwo_mmtp_unlock;
+  out->base.mmtp_flush = &mmaptwo_mmtp_flush;
+  out->base.mmtp_resize = &mmaptwo_mmtp_resize;
+  out->base.mmtp_residency = &mmaptwo_mmtp_residency;
+  out->locked = 0u;
+  return;
+}
+
+int mmaptwo_batch_cmp(void const* a, void const* b) {
+  struct mmaptwo_batch_unix const* const ra =
+    (struct mmaptwo_batch_unix const*)a;
+  struct mmaptwo_batch_unix const* const rb =
+    (struct mmaptwo_batch_unix const*)b;
+  if (ra->off != rb->off)
+    return (ra->off < rb->off) ? -1 : +1;
+  else if (ra->idx != rb->idx)
+    return (ra->idx < rb->idx) ? -1 : +1;
+  else return 0;
+}
+
+int mmaptwo_mmt_acquire_batch
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved)
+{
+  int const res =
+    mmaptwo_mmt_acquire_group(m, n, ranges, pages, flags, saved);
+  if (res != 0) {
+    mmaptwo_stat_fail(&((struct mmaptwo_unix*)m)->stats, res);
+  }
+  return res;
+}
+
+int mmaptwo_mmt_acquire_group
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved)
+{
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  size_t const len = mmaptwo_atomic_get(&mu->len);
+  struct mmaptwo_batch_unix* order;
+  size_t maps = 0u;
+  size_t i, j;
+  int res = 0;
+  if (saved != NULL)
+    *saved = 0u;
+  for (i = 0u; i < n; ++i) {
+    pages[i] = NULL;
+    if (ranges[i].off > len
+    ||  ranges[i].siz > len-ranges[i].off
+    ||  ranges[i].siz == 0u)
+    {
+      return EDOM;
+    }
+  }
+  if (n == 0u) {
+    return 0;
+  }
+  if (flags & mmaptwo_acquire_resident) {
+    /* check every range before mapping any */
+    int cold = 0;
+    for (i = 0u; i < n; ++i) {
+      res = mmaptwo_mmt_resident(mu, ranges[i].off, ranges[i].siz);
+      if (res == MMAPTWO_EWOULDBLOCK) {
+        cold = 1;
+      } else if (res != 0) {
+        return res;
+      }
+    }
+    if (cold) {
+      return MMAPTWO_EWOULDBLOCK;
+    }
+    res = 0;
+  }
+  order = calloc(n, sizeof(struct mmaptwo_batch_unix));
+  if (order == NULL) {
+    return errno;
+  }
+  for (i = 0u; i < n; ++i) {
+    order[i].off = ranges[i].off;
+    order[i].siz = ranges[i].siz;
+    order[i].idx = i;
+  }
+  qsort(order, n, sizeof(struct mmaptwo_batch_unix), &mmaptwo_batch_cmp);
+  for (i = 0u; i < n && res == 0; i = j) {
+    size_t const first = mu->offnum+order[i].off;
+    size_t end = first+order[i].siz;
+    size_t mapoff;
+    size_t mapsize;
+    size_t k;
+    void* ptr;
+    struct mmaptwo_view_unix* view;
+    int populate = mu->mt.populate || (flags & mmaptwo_acquire_populate);
+    /* gather the neighbours that this mapping will serve */
+    for (j = i+1u; j < n; ++j) {
+      size_t const next = mu->offnum+order[j].off;
+      if ((flags & mmaptwo_acquire_separate)
+      ||  (next > end && next-end > mu->align))
+      {
+        break;
+      }
+      if (next+order[j].siz > end)
+        end = next+order[j].siz;
+    }
+    if (j-i == 1u
+    ||  (mu->premap_ptr != NULL
+        && end-mu->offnum <= mu->premap_len-mu->premap_shift))
+    {
+      /* the usual path serves lone ranges and the premap best */
+      for (k = i; k < j; ++k) {
+        size_t const idx = order[k].idx;
+        int mapped;
+        pages[idx] = mmaptwo_mmt_acquire_page
+          (m, order[k].siz, order[k].off, flags, &mapped);
+        if (pages[idx] == NULL) {
+          res = errno;
+          break;
+        } else if (mapped)
+          maps += 1u;
+      }
+      continue;
+    }
+    /* take page handles first, so that failure leaves nothing mapped */
+    for (k = i; k < j; ++k) {
+      size_t const idx = order[k].idx;
+      struct mmaptwo_page_unix* const pu = mmaptwo_pool_take(mu);
+      if (pu == NULL) {
+        res = errno;
+        break;
+      }
+      pages[idx] = (struct mmaptwo_page_i*)pu;
+    }
+    if (res != 0) {
+      for (k = i; k < j; ++k) {
+        size_t const idx = order[k].idx;
+        if (pages[idx] != NULL) {
+          mmaptwo_pool_give(mu, (struct mmaptwo_page_unix*)pages[idx]);
+          pages[idx] = NULL;
+        }
+      }
+      break;
+    }
+    mapoff = first-first%mu->align;
+    mapsize = end-mapoff;
+#if (defined MAP_POPULATE)
+    if (populate && (!mu->mt.huge || mu->hugetlb)) {
+      ptr = mmaptwo_map(mu, &mapsize, mapoff, MAP_POPULATE);
+      populate = 0;
+    } else
+#endif /*MAP_POPULATE*/
+    ptr = mmaptwo_map(mu, &mapsize, mapoff, 0);
+    view = (ptr != MAP_FAILED)
+      ? mmaptwo_view_add(mu, ptr, mapsize, mapoff, j-i)
+      : NULL;
+    if (view == NULL) {
+      res = errno;
+      if (ptr != MAP_FAILED)
+        mmaptwo_unmap(mu, ptr, mapsize);
+      for (k = i; k < j; ++k) {
+        size_t const idx = order[k].idx;
+        mmaptwo_pool_give(mu, (struct mmaptwo_page_unix*)pages[idx]);
+        pages[idx] = NULL;
+      }
+      break;
+    }
+    maps += 1u;
+    /* apply the instance's advice */{
+      int const advice = (int)mmaptwo_atomic_get(&mu->advice);
+      if (advice != mmaptwo_advice_normal) {
+        mmaptwo_madvise(ptr, mapsize, advice);
+      }
+    }
+    for (k = i; k < j; ++k) {
+      size_t const idx = order[k].idx;
+      struct mmaptwo_page_unix* const pu =
+        (struct mmaptwo_page_unix*)pages[idx];
+      pu->borrow = 0;
+      pu->view = view;
+      mmaptwo_page_init(mu, pu, ptr,
+        mu->offnum+order[k].off-mapoff, order[k].siz, order[k].off);
+      if (populate) {
+        mmaptwo_populate(mu, pu);
+      }
+    }
+  }
+  free(order);
+  if (res != 0) {
+    for (i = 0u; i < n; ++i) {
+      if (pages[i] != NULL) {
+        mmaptwo_page_close(pages[i]);
+        pages[i] = NULL;
+      }
+    }
+  } else if (saved != NULL) {
+    *saved = n-maps;
+  }
+  return res;
+}
+
+int mmaptwo_madvise(void* ptr, size_t len, int advice) {
+#if (defined MADV_NORMAL)
+  int flag;
+  switch (advice) {
+  case mmaptwo_advice_normal:     flag = MADV_NORMAL; break;
+  case mmaptwo_advice_sequential: flag = MADV_SEQUENTIAL; break;
+  case mmaptwo_advice_random:     flag = MADV_RANDOM; break;
+  case mmaptwo_advice_willneed:   flag = MADV_WILLNEED; break;
+  case mmaptwo_advice_dontneed:   flag = MADV_DONTNEED; break;
+#  if (defined MADV_COLD)
+  case mmaptwo_advice_cold:       flag = MADV_COLD; break;
+#  endif /*MADV_COLD*/
+#  if (defined MADV_PAGEOUT)
+  case mmaptwo_advice_pageout:    flag = MADV_PAGEOUT; break;
+#  endif /*MADV_PAGEOUT*/
+  default:
+    return MMAPTWO_ENOSYS;
+  }
+  return madvise(ptr, len, flag) != 0 ? errno : 0;
+#else
+  int flag;
+  switch (advice) {
+  case mmaptwo_advice_normal:     flag = POSIX_MADV_NORMAL; break;
+  case mmaptwo_advice_sequential: flag = POSIX_MADV_SEQUENTIAL; break;
+  case mmaptwo_advice_random:     flag = POSIX_MADV_RANDOM; break;
+  case mmaptwo_advice_willneed:   flag = POSIX_MADV_WILLNEED; break;
+  case mmaptwo_advice_dontneed:   flag = POSIX_MADV_DONTNEED; break;
+  default:
+    return MMAPTWO_ENOSYS;
+  }
+  return posix_madvise(ptr, len, flag);
+#endif /*MADV_NORMAL*/
+}
+
+int mmaptwo_mmt_advise(struct mmaptwo_i* m, int advice) {
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  if (advice < mmaptwo_advice_normal || advice > mmaptwo_advice_pageout) {
+    return EINVAL;
+  }
+  if (mu->premap_ptr != NULL) {
+    int const res = mmaptwo_madvise(mu->premap_ptr, mu->premap_len, advice);
+    if (res != 0) {
+      return res;
+    }
+  }
+  mmaptwo_atomic_set(&mu->advice, (size_t)advice);
+  return 0;
+}
+
+int mmaptwo_mmtp_advise(struct mmaptwo_page_i* p, int advice) {
+  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
+  size_t lead = pu->shift;
+  /* align the start of the range to a page, as `ptr` already is */{
+    long const psize = sysconf(_SC_PAGE_SIZE);
+    if (psize > 0) {
+      lead -= lead%((unsigned long)psize);
+    }
+  }
+  return mmaptwo_madvise((unsigned char*)pu->ptr+lead, pu->len-lead, advice);
+}
+
+size_t mmaptwo_mmt_length(struct mmaptwo_i const* m) {
+  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
+  return mmaptwo_atomic_get(&mu->len);
+}
+
+int mmaptwo_file_grow(int fd, size_t cur, size_t sz) {
+  int res = posix_fallocate(fd, (off_t)cur, (off_t)(sz-cur));
+  if (res == EINVAL
+#if (defined EOPNOTSUPP)
+  ||  res == EOPNOTSUPP
+#endif /*EOPNOTSUPP*/
+  )
+  {
+    /* the file system cannot allocate, so leave a hole */
+    res = (ftruncate(fd, (off_t)sz) != 0) ? errno : 0;
+  }
+  return res;
+}
+
+int mmaptwo_file_reserve
+  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+{
+  size_t cur;
+  if (sz > (~(size_t)0u)-off) {
+    return ERANGE;
+  } else if (mt.mode != mmaptwo_mode_write) {
+    return EBADF;
+  }
+  if (mt.keep) {
+#if (defined FALLOC_FL_KEEP_SIZE)
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t)off, (off_t)sz) != 0) {
+      int const err = errno;
+      if (err != EINVAL && err != ENOSYS
+#  if (defined EOPNOTSUPP)
+      &&  err != EOPNOTSUPP
+#  endif /*EOPNOTSUPP*/
+      )
+      {
+        return err;
+      }
+      /* else the file system cannot reserve, so skip it */
+    }
+#endif /*FALLOC_FL_KEEP_SIZE*/
+    return 0;
+  }
+  cur = mmaptwo_file_size_e(fd);
+  if (cur >= off+sz) {
+    /* keep existing contents and length as they are */
+    return 0;
+  }
+  return mmaptwo_file_grow(fd, (cur < off) ? cur : off, off+sz);
+}
+
+int mmaptwo_memfd
+  (char const* nm, struct mmaptwo_mode_tag const mt, size_t* sz)
+{
+  int fd = -1;
+  if (*sz == 0u) {
+    errno = ERANGE;
+    return -1;
+  }
+#if (defined MFD_CLOEXEC)
+  /* use an anonymous memory file */{
+    unsigned int flags = MFD_CLOEXEC;
+#  if (defined MFD_ALLOW_SEALING)
+    if (mt.seal)
+      flags |= MFD_ALLOW_SEALING;
+#  endif /*MFD_ALLOW_SEALING*/
+#  if (defined MFD_HUGETLB)
+    if (mt.huge) {
+      fd = memfd_create(nm, flags|MFD_HUGETLB);
+      if (fd != -1) {
+        /* `hugetlbfs` files hold whole huge pages only */
+        struct statfs fsi;
+        size_t hsz = *sz;
+        if (fstatfs(fd, &fsi) == 0 && fsi.f_bsize > 0) {
+          size_t const hsize = (size_t)fsi.f_bsize;
+          size_t const extra = hsz % hsize;
+          if (extra > 0u && hsize-extra <= (~(size_t)0u)-hsz)
+            hsz += hsize-extra;
+        }
+        /* claim the huge pages now, or fall back to small pages */
+        if (fallocate(fd, 0, 0, (off_t)hsz) == 0) {
+          *sz = hsz;
+        } else {
+          close(fd);
+          fd = -1;
+        }
+      }
+    }
+#  endif /*MFD_HUGETLB*/
+    if (fd == -1)
+      fd = memfd_create(nm, flags);
+  }
+#elif (defined _POSIX_SHARED_MEMORY_OBJECTS) \
+   && (_POSIX_SHARED_MEMORY_OBJECTS > 0)
+  /* use a shared memory object, unlinked right away */{
+    static size_t volatile serial = 0u;
+    char shm_name[64];
+    int tries;
+    (void)nm;
+    for (tries = 0; tries < 16 && fd == -1; ++tries) {
+      sprintf(shm_name, "/mmaptwo.%ld.%lu", (long)getpid(),
+        (unsigned long)mmaptwo_atomic_add(&serial, 1u));
+      fd = shm_open(shm_name, O_RDWR|O_CREAT|O_EXCL, 0600);
+      if (fd != -1)
+        shm_unlink(shm_name);
+      else if (errno != EEXIST)
+        break;
+    }
+  }
+#else
+  (void)nm;
+  errno = MMAPTWO_ENOSYS;
+#endif /*MFD_CLOEXEC*/
+  if (fd == -1) {
+    return -1;
+  }
+  if (ftruncate(fd, (off_t)*sz) != 0) {
+    int const err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+#if (defined F_ADD_SEALS) && (defined MFD_ALLOW_SEALING)
+  if (mt.seal
+  &&  fcntl(fd, F_ADD_SEALS, F_SEAL_GROW|F_SEAL_SHRINK|F_SEAL_SEAL) != 0)
+  {
+    int const err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+#endif /*F_ADD_SEALS*/
+  return fd;
+}
+
+int mmaptwo_mmt_extend(struct mmaptwo_i* m, size_t sz) {
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  size_t const before = mmaptwo_atomic_get(&mu->len);
+  size_t const start = mmaptwo_clock_now();
+  int const res = mmaptwo_mmt_grow(m, sz);
+  mmaptwo_trace_emit(MMAPTWO_TRACE_EXTEND, m, sz, before,
+    mmaptwo_clock_since(start), res);
+  return res;
+}
+
+int mmaptwo_mmt_grow(struct mmaptwo_i* m, size_t sz) {
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  size_t end;
+  int res = 0;
+  if (sz > (~(size_t)0u)-mu->offnum) {
+    return ERANGE;
+  }
+  end = mu->offnum+sz;
+  pthread_mutex_lock(&mu->grow_lock);
+  if (sz > mmaptwo_atomic_get(&mu->len)) {
+    int const fd = mmaptwo_fd_hold(mu);
+    size_t const cur = (fd != -1) ? mmaptwo_file_size_e(fd) : 0u;
+    if (fd == -1) {
+      res = errno;
+    } else if (cur < end) {
+      if (mu->mt.mode != mmaptwo_mode_write) {
+        res = EBADF;
+      } else {
+        /* grow geometrically, so that appends amortize the calls */
+        size_t step = cur/2u;
+        size_t target;
+        if (step > (size_t)(MMAPTWO_GROW_MAX))
+          step = (size_t)(MMAPTWO_GROW_MAX);
+        target = (step > (~(size_t)0u)-cur || cur+step < end
+            || (mu->mt.create && mu->mt.keep))
+          ? end : cur+step;
+        res = mmaptwo_file_grow(fd, cur, target);
+        if (res == 0) {
+          /* remember the extra length, to trim at close */
+          mu->grown = (target > end) ? target : 0u;
+        }
+      }
+    }
+    if (fd != -1) {
+      mmaptwo_fd_drop(mu);
+    }
+    if (res == 0) {
+      mmaptwo_atomic_set(&mu->len, sz);
+    }
+  }
+  pthread_mutex_unlock(&mu->grow_lock);
+  return res;
+}
+
+size_t mmaptwo_mmtp_length(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_page_unix const* const pu =
+    (struct mmaptwo_page_unix const*)p;
+  return pu->len-pu->shift;
+}
+
+size_t mmaptwo_mmt_offset(struct mmaptwo_i const* m) {
+  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
+  return mu->offnum;
+}
+
+int mmaptwo_mmt_fd(struct mmaptwo_i const* m) {
+  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
+  if (mu->dir != NULL) {
+    /* the descriptor cache may close and reuse this number */
+    errno = MMAPTWO_ENOSYS;
+    return -1;
+  }
+  return mu->fd;
+}
+
+int mmaptwo_fd_hold(struct mmaptwo_unix* mu) {
+  struct mmaptwo_dir* const d = mu->dir;
+  int fd;
+  int extra = -1;
+  int victim;
+  if (d == NULL) {
+    if (mu->fd == -1)
+      errno = EBADF;
+    return mu->fd;
+  }
+  mmaptwo_spin_lock(&d->lock);
+  fd = mu->fd;
+  if (fd == -1 && !mu->closed) {
+    /* reopen outside the lock, since the path walk may block */
+    struct stat fsi;
+    mmaptwo_spin_unlock(&d->lock);
+    fd = openat(d->fd, mu->name, mmaptwo_mode_rw_cvt(mu->mt.mode));
+    if (fd != -1 && (fstat(fd, &fsi) != 0
+        || fsi.st_dev != mu->dev || fsi.st_ino != mu->ino))
+    {
+      /* make sure that the name still leads to the same file */
+      close(fd);
+      fd = -1;
+#if (defined ESTALE)
+      errno = ESTALE;
+#else
+      errno = ENOENT;
+#endif /*ESTALE*/
+    }
+    if (fd != -1 && mu->mt.bequeath) {
+      int const old_flags = fcntl(fd, F_GETFD);
+      if (old_flags >= 0)
+        fcntl(fd, F_SETFD, old_flags&(~FD_CLOEXEC));
+    }
+    if (fd == -1) {
+      return -1;
+    }
+    mmaptwo_spin_lock(&d->lock);
+    if (mu->fd == -1 && !mu->closed) {
+      /* publish the new descriptor */
+      mu->fd = fd;
+      d->fds += 1u;
+      d->reopens += 1u;
+    } else {
+      /* another thread reopened first, or the instance closed */
+      extra = fd;
+      fd = mu->fd;
+    }
+  }
+  victim = -1;
+  if (fd != -1) {
+    mu->fd_busy += 1u;
+    if (d->lru_head != mu) {
+      /* move to the front of the list */
+      mu->fd_prev->fd_next = mu->fd_next;
+      if (mu->fd_next != NULL)
+        mu->fd_next->fd_prev = mu->fd_prev;
+      else d->lru_tail = mu->fd_prev;
+      mu->fd_prev = NULL;
+      mu->fd_next = d->lru_head;
+      d->lru_head->fd_prev = mu;
+      d->lru_head = mu;
+    }
+    victim = mmaptwo_dir_trim(d, mu);
+  } else errno = EBADF;
+  mmaptwo_spin_unlock(&d->lock);
+  if (extra != -1)
+    close(extra);
+  if (victim != -1)
+    close(victim);
+  return fd;
+}
+
+void mmaptwo_fd_drop(struct mmaptwo_unix* mu) {
+  struct mmaptwo_dir* const d = mu->dir;
+  if (d != NULL) {
+    mmaptwo_spin_lock(&d->lock);
+    mu->fd_busy -= 1u;
+    mmaptwo_spin_unlock(&d->lock);
+  }
+  return;
+}
+
+int mmaptwo_dir_trim(struct mmaptwo_dir* d, struct mmaptwo_unix* keep) {
+  struct mmaptwo_unix* it;
+  if (d->fds <= d->max) {
+    return -1;
+  }
+  for (it = d->lru_tail; it != NULL; it = it->fd_prev) {
+    if (it != keep && it->fd != -1 && it->fd_busy == 0u) {
+      /* live mappings do not need the descriptor */
+      int const fd = it->fd;
+      it->fd = -1;
+      d->fds -= 1u;
+      d->closes += 1u;
+      return fd;
+    }
+  }
+  return -1;
+}
+
+int mmaptwo_mmt_set_prefetch(struct mmaptwo_i* m, int on) {
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  if (on) {
+    mmaptwo_atomic_set(&mu->pf_used, 1u);
+  }
+  mmaptwo_atomic_set(&mu->pf_on, on ? 1u : 0u);
+  return 0;
+}
+
+int mmaptwo_mmt_prefetch_stats
+  (struct mmaptwo_i* m, struct mmaptwo_prefetch_stats* st)
+{
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  mmaptwo_spin_lock(&mu->pf_lock);
+  *st = mu->pf_stats;
+  mmaptwo_spin_unlock(&mu->pf_lock);
+  return 0;
+}
+
+int mmaptwo_mmt_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset)
+{
+  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
+  return mmaptwo_stat_read(&mu->stats, st, reset);
+}
+
+size_t mmaptwo_clock_now(void) {
+  struct timespec ts;
+#if !MMAPTWO_STATS && !MMAPTWO_USDT
+  if (mmaptwo_atomic_get(&mmaptwo_trace_table) == 0u) {
+    /* nothing needs the time */
+    return 0u;
+  }
+#endif /*MMAPTWO_STATS*/
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+    return 0u;
+  }
+  return (size_t)ts.tv_sec*1000000000u + (size_t)ts.tv_nsec;
+}
+
+size_t mmaptwo_clock_since(size_t start) {
+  size_t now;
+  if (start == 0u) {
+    return 0u;
+  }
+  now = mmaptwo_clock_now();
+  return (now != 0u) ? now-start : 0u;
+}
+
+void mmaptwo_trace_emit
+  ( int point, struct mmaptwo_i const* m, size_t siz, size_t off,
+    size_t ns, int err)
+{
+  struct mmaptwo_trace_hooks const* const hooks =
+    (struct mmaptwo_trace_hooks const*)
+      mmaptwo_atomic_get(&mmaptwo_trace_table);
+  void (*fn)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err) = NULL;
+  switch (point) {
+  case MMAPTWO_TRACE_OPEN:
+    MMAPTWO_PROBE(open, m, siz, off, ns, err);
+    if (hooks != NULL)
+      fn = hooks->open;
+    break;
+  case MMAPTWO_TRACE_ACQUIRE_BEGIN:
+    MMAPTWO_PROBE(acquire__begin, m, siz, off, ns, err);
+    if (hooks != NULL)
+      fn = hooks->acquire_begin;
+    break;
+  case MMAPTWO_TRACE_ACQUIRE_END:
+    MMAPTWO_PROBE(acquire__end, m, siz, off, ns, err);
+    if (hooks != NULL)
+      fn = hooks->acquire_end;
+    break;
+  case MMAPTWO_TRACE_PAGE_CLOSE:
+    MMAPTWO_PROBE(page__close, m, siz, off, ns, err);
+    if (hooks != NULL)
+      fn = hooks->page_close;
+    break;
+  case MMAPTWO_TRACE_FLUSH:
+    MMAPTWO_PROBE(flush, m, siz, off, ns, err);
+    if (hooks != NULL)
+      fn = hooks->flush;
+    break;
+  case MMAPTWO_TRACE_EXTEND:
+    MMAPTWO_PROBE(extend, m, siz, off, ns, err);
+    if (hooks != NULL)
+      fn = hooks->extend;
+    break;
+  }
+  if (fn != NULL) {
+    fn(hooks->arg, m, siz, off, ns, err);
+  }
+  return;
+}
+
+void mmaptwo_latency_record(int op, size_t ns) {
+#if MMAPTWO_STATS
+  struct mmaptwo_latency_block* const b = mmaptwo_latency_get();
+  if (b != NULL) {
+    mmaptwo_stat_add(&b->counts[op][mmaptwo_latency_bucket(ns)], 1u);
+  }
+#else
+  (void)op;
+  (void)ns;
+#endif /*MMAPTWO_STATS*/
+  return;
+}
+
+#if MMAPTWO_STATS
+void mmaptwo_latency_init(void) {
+  mmaptwo_latency.ready =
+    (pthread_key_create(&mmaptwo_latency.key, &mmaptwo_latency_exit) == 0);
+  return;
+}
+
+void mmaptwo_latency_exit(void* arg) {
+  struct mmaptwo_latency_block* const b =
+    (struct mmaptwo_latency_block*)arg;
+  mmaptwo_atomic_set(&b->owned, 0u);
+  return;
+}
+
+struct mmaptwo_latency_block* mmaptwo_latency_get(void) {
+  struct mmaptwo_latency_block* b;
+  if (pthread_once(&mmaptwo_latency.once, &mmaptwo_latency_init) != 0
+  ||  !mmaptwo_latency.ready)
+  {
+    return NULL;
+  }
+  b = (struct mmaptwo_latency_block*)
+    pthread_getspecific(mmaptwo_latency.key);
+  if (b != NULL) {
+    return b;
+  }
+  /* take over the block of an exited thread, else make one */
+  pthread_mutex_lock(&mmaptwo_latency.lock);
+  for (b = mmaptwo_latency.head; b != NULL; b = b->next) {
+    if (mmaptwo_atomic_cas(&b->owned, 0u, 1u))
+      break;
+  }
+  if (b == NULL) {
+    b = calloc(1, sizeof(struct mmaptwo_latency_block));
+    if (b != NULL) {
+      b->owned = 1u;
+      b->next = mmaptwo_latency.head;
+      mmaptwo_latency.head = b;
+    }
+  }
+  pthread_mutex_unlock(&mmaptwo_latency.lock);
+  if (b != NULL && pthread_setspecific(mmaptwo_latency.key, b) != 0) {
+    mmaptwo_atomic_set(&b->owned, 0u);
+    b = NULL;
+  }
+  return b;
+}
+
+size_t mmaptwo_latency_bucket(size_t ns) {
+  /* find the shift that leaves six significant bits */
+  size_t shift = 0u;
+  while ((ns>>shift) >= 64u) {
+    shift += 1u;
+  }
+  return shift*32u + (ns>>shift);
+}
+
+size_t mmaptwo_latency_bound(size_t idx) {
+  if (idx < 64u) {
+    return idx;
+  } else {
+    size_t const shift = idx/32u - 1u;
+    size_t const top = idx%32u + 32u;
+    /* wraps to the greatest value for the last bucket */
+    return ((top+1u)<<shift) - 1u;
+  }
+}
+#endif /*MMAPTWO_STATS*/
+
+void mmaptwo_prefetch_note
+  (struct mmaptwo_unix* mu, size_t off, size_t sz)
+{
+  size_t const len = mmaptwo_atomic_get(&mu->len);
+  size_t depth = mmaptwo_atomic_get(&mmaptwo_prefetch.depth);
+  size_t jobs[MMAPTWO_PREFETCH_TABLE/2];
+  size_t n = 0u;
+  size_t i;
+  mmaptwo_spin_lock(&mu->pf_lock);
+  /* score an earlier prediction */
+  for (i = 0u; i < MMAPTWO_PREFETCH_TABLE; ++i) {
+    if (mu->pf_siz[i] > 0u
+    &&  off >= mu->pf_off[i] && off-mu->pf_off[i] < mu->pf_siz[i])
+    {
+      mu->pf_siz[i] = 0u;
+      mu->pf_stats.useful += 1u;
+      break;
+    }
+  }
+  /* track the stride; unsigned wrap-around covers backward strides */
+  if (off-mu->pf_last == mu->pf_stride && mu->pf_stride != 0u) {
+    mu->pf_repeat += 1u;
+  } else {
+    mu->pf_stride = off-mu->pf_last;
+    mu->pf_repeat = 0u;
+  }
+  mu->pf_last = off;
+  if (depth > MMAPTWO_PREFETCH_TABLE/2)
+    depth = MMAPTWO_PREFETCH_TABLE/2;
+  if (mu->pf_repeat > 0u) {
+    size_t next = off;
+    size_t k;
+    for (k = 0u; k < depth; ++k) {
+      int known = 0;
+      next += mu->pf_stride;
+      if (next > len || sz > len-next)
+        break;
+      for (i = 0u; i < MMAPTWO_PREFETCH_TABLE && !known; ++i) {
+        known = (mu->pf_siz[i] > 0u && mu->pf_off[i] == next);
+      }
+      if (known)
+        continue;
+      /* remember the prediction, forgetting the oldest */
+      if (mu->pf_siz[mu->pf_next] > 0u)
+        mu->pf_stats.wasted += 1u;
+      mu->pf_off[mu->pf_next] = next;
+      mu->pf_siz[mu->pf_next] = sz;
+      mu->pf_next = (mu->pf_next+1u)%MMAPTWO_PREFETCH_TABLE;
+      jobs[n++] = next;
+    }
+  }
+  mmaptwo_spin_unlock(&mu->pf_lock);
+  if (n > 0u) {
+    size_t queued = 0u;
+    pthread_mutex_lock(&mmaptwo_prefetch.lock);
+    if (mmaptwo_prefetch.running && !mmaptwo_prefetch.stop) {
+      for (i = 0u; i < n
+          && mmaptwo_prefetch.count < MMAPTWO_PREFETCH_QUEUE; ++i)
+      {
+        struct mmaptwo_prefetch_job* const job = mmaptwo_prefetch.queue
+          + (mmaptwo_prefetch.head+mmaptwo_prefetch.count)
+            % MMAPTWO_PREFETCH_QUEUE;
+        job->mu = mu;
+        job->off = jobs[i];
+        job->siz = sz;
+        mmaptwo_prefetch.count += 1u;
+        queued += 1u;
+      }
+      /* wake every worker for a burst, so that its jobs spread out */
+      if (queued > 1u)
+        pthread_cond_broadcast(&mmaptwo_prefetch.work);
+      else if (queued > 0u)
+        pthread_cond_signal(&mmaptwo_prefetch.work);
+    }
+    pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+    mmaptwo_spin_lock(&mu->pf_lock);
+    mu->pf_stats.issued += queued;
+    mu->pf_stats.dropped += n-queued;
+    /* forget the predictions that found no room */
+    for (; queued < n; ++queued) {
+      for (i = 0u; i < MMAPTWO_PREFETCH_TABLE; ++i) {
+        if (mu->pf_siz[i] > 0u && mu->pf_off[i] == jobs[queued]) {
+          mu->pf_siz[i] = 0u;
+          break;
+        }
+      }
+    }
+    mmaptwo_spin_unlock(&mu->pf_lock);
+  }
+  return;
+}
+
+void mmaptwo_prefetch_detach(struct mmaptwo_unix* mu) {
+  size_t i, kept = 0u;
+  mmaptwo_atomic_set(&mu->pf_on, 0u);
+  pthread_mutex_lock(&mmaptwo_prefetch.lock);
+  /* drop this instance's jobs, keeping the order of the rest */
+  for (i = 0u; i < mmaptwo_prefetch.count; ++i) {
+    struct mmaptwo_prefetch_job const job = mmaptwo_prefetch.queue
+      [(mmaptwo_prefetch.head+i)%MMAPTWO_PREFETCH_QUEUE];
+    if (job.mu != mu) {
+      mmaptwo_prefetch.queue
+        [(mmaptwo_prefetch.head+kept)%MMAPTWO_PREFETCH_QUEUE] = job;
+      kept += 1u;
+    }
+  }
+  mmaptwo_prefetch.count = kept;
+  while (mu->pf_running > 0u) {
+    pthread_cond_wait(&mmaptwo_prefetch.idle, &mmaptwo_prefetch.lock);
+  }
+  pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+  return;
+}
+
+void mmaptwo_populate_async
+  (struct mmaptwo_unix* mu, size_t off, size_t sz)
+{
+  int queued = 0;
+  pthread_mutex_lock(&mmaptwo_prefetch.lock);
+  if (mmaptwo_prefetch.running && !mmaptwo_prefetch.stop
+  &&  mmaptwo_prefetch.count < MMAPTWO_PREFETCH_QUEUE)
+  {
+    struct mmaptwo_prefetch_job* const job = mmaptwo_prefetch.queue
+      + (mmaptwo_prefetch.head+mmaptwo_prefetch.count)
+        % MMAPTWO_PREFETCH_QUEUE;
+    /* the destructor must wait out this job */
+    mmaptwo_atomic_set(&mu->pf_used, 1u);
+    job->mu = mu;
+    job->off = off;
+    job->siz = sz;
+    mmaptwo_prefetch.count += 1u;
+    pthread_cond_signal(&mmaptwo_prefetch.work);
+    queued = 1;
+  }
+  pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+  if (!queued) {
+    int const fd = mmaptwo_fd_hold(mu);
+    if (fd != -1) {
+      posix_fadvise(fd, (off_t)(mu->offnum+off), (off_t)sz,
+          POSIX_FADV_WILLNEED);
+      mmaptwo_fd_drop(mu);
+    }
+  }
+  return;
+}
+
+int mmaptwo_mmt_resident
+  (struct mmaptwo_unix* mu, size_t off, size_t sz)
+{
+  size_t resident;
+  int const res = mmaptwo_mmt_residency
+    ((struct mmaptwo_i*)mu, sz, off, NULL, &resident);
+  if (res != 0) {
+    return res;
+  } else if (resident < sz) {
+    mmaptwo_populate_async(mu, off, sz);
+    return MMAPTWO_EWOULDBLOCK;
+  }
+  return 0;
+}
+
+void* mmaptwo_prefetch_main(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&mmaptwo_prefetch.lock);
+  for (;;) {
+    struct mmaptwo_prefetch_job job;
+    while (!mmaptwo_prefetch.stop && mmaptwo_prefetch.count == 0u) {
+      pthread_cond_wait(&mmaptwo_prefetch.work, &mmaptwo_prefetch.lock);
+    }
+    if (mmaptwo_prefetch.stop) {
+      break;
+    }
+    job = mmaptwo_prefetch.queue[mmaptwo_prefetch.head];
+    mmaptwo_prefetch.head =
+      (mmaptwo_prefetch.head+1u)%MMAPTWO_PREFETCH_QUEUE;
+    mmaptwo_prefetch.count -= 1u;
+    job.mu->pf_running += 1u;
+    pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+    /* read ahead into the page cache */{
+      int const fd = mmaptwo_fd_hold(job.mu);
+      if (fd != -1) {
+        size_t const off = job.mu->offnum+job.off;
+#if (defined __linux__)
+        readahead(fd, (off_t)off, job.siz);
+#else
+        posix_fadvise(fd, (off_t)off, (off_t)job.siz, POSIX_FADV_WILLNEED);
+#endif /*__linux__*/
+        mmaptwo_fd_drop(job.mu);
+      }
+    }
+    pthread_mutex_lock(&mmaptwo_prefetch.lock);
+    job.mu->pf_running -= 1u;
+    pthread_cond_broadcast(&mmaptwo_prefetch.idle);
+  }
+  pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+  return NULL;
+}
+
+void mmaptwo_dir_release(struct mmaptwo_dir* d) {
+  if (mmaptwo_atomic_add(&d->refs, ~(size_t)0u) == 0u) {
+    close(d->fd);
+    free(d);
+  }
+  return;
+}
+
+size_t mmaptwo_mmtp_offset(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_page_unix const* const pu =
+    (struct mmaptwo_page_unix const*)p;
+  return pu->offnum;
+}
+
+void mmaptwo_ring_release(struct mmaptwo_ring* r) {
+  if (mmaptwo_atomic_add(&r->refs, ~(size_t)0u) == 0u) {
+    munmap(r->base, r->cap*2u);
+    free(r);
+  }
+  return;
+}
+
+size_t mmaptwo_ring_step
+  (struct mmaptwo_ring const* r, size_t pos, size_t n)
+{
+  pos += n;
+  return (pos >= r->cap*2u) ? pos-r->cap*2u : pos;
+}
+
+void mmaptwo_ringp_dtor(struct mmaptwo_page_i* p) {
+  struct mmaptwo_ring_page* const rp = (struct mmaptwo_ring_page*)p;
+  mmaptwo_ring_release(rp->src);
+  free(rp);
+  return;
+}
+
+void* mmaptwo_ringp_get(struct mmaptwo_page_i* p) {
+  struct mmaptwo_ring_page* const rp = (struct mmaptwo_ring_page*)p;
+  return rp->ptr;
+}
+
+void const* mmaptwo_ringp_getconst(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_ring_page const* const rp =
+    (struct mmaptwo_ring_page const*)p;
+  return rp->ptr;
+}
+
+size_t mmaptwo_ringp_length(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_ring_page const* const rp =
+    (struct mmaptwo_ring_page const*)p;
+  return rp->len;
+}
+
+size_t mmaptwo_ringp_offset(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_ring_page const* const rp =
+    (struct mmaptwo_ring_page const*)p;
+  return rp->off;
+}
+#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
+DWORD mmaptwo_mode_rw_cvt(int mmode) {
+  switch (mmode) {
+  case mmaptwo_mode_write:
+    return GENERIC_READ|GENERIC_WRITE;
+  case mmaptwo_mode_read:
+    return GENERIC_READ;
+  default:
+    return 0;
+  }
+}
+
+DWORD mmaptwo_mode_disposition_cvt(int mmode) {
+  switch (mmode) {
+  case mmaptwo_mode_write:
+    return OPEN_ALWAYS;
+  case mmaptwo_mode_read:
+    return OPEN_EXISTING;
+  default:
+    return 0;
+  }
+}
+
+int mmaptwo_u8towc_shim
+  (unsigned char const* nm, wchar_t* out, size_t* outlen)
+{
+  size_t n = 0;
+  unsigned char const* p;
+  static size_t const sz_max = UINT_MAX/2u-4u;
+  for (p = nm; *p && n < sz_max; ++p) {
+    unsigned char const v = *p;
+    if (n >= sz_max) {
+      return ERANGE;
+    }
+    if (v < 0x80) {
+      /* Latin-1 compatibility */
+      if (out != NULL) {
+        out[n] = v;
+      }
+      n += 1;
+    } else if (v < 0xC0) {
+      return MMAPTWO_EILSEQ;
+    } else if (v < 0xE0) {
+      /* check extension codes */
+      unsigned int i;
+      unsigned long int qv = v&31;
+      for (i = 0; i < 1; ++i) {
+        unsigned char const v1 = *(p+i);
+        if (v1 < 0x80 || v1 >= 0xC0) {
+          return MMAPTWO_EILSEQ;
+        } else qv = (qv<<6)|(v1&63);
+      }
+      if (out != NULL) {
+        out[n] = (wchar_t)qv;
+      }
+      n += 1;
+      p += 1;
+    } else if (v < 0xF0) {
+      /* check extension codes */
+      unsigned int i;
+      unsigned long int qv = v&15;
+      for (i = 0; i < 2; ++i) {
+        unsigned char const v1 = *(p+i);
+        if (v1 < 0x80 || v1 >= 0xC0) {
+          return MMAPTWO_EILSEQ;
+        } else qv = (qv<<6)|(v1&63);
+      }
+      if (out != NULL) {
+        out[n] = (wchar_t)qv;
+      }
+      n += 1;
+      p += 2;
+    } else if (v < 0xF8) {
+      /* check extension codes */
+      unsigned int i;
+      unsigned long int qv = v&3;
+      for (i = 0; i < 3; ++i) {
+        unsigned char const v1 = *(p+i);
+        if (v1 < 0x80 || v1 >= 0xC0) {
+          return MMAPTWO_EILSEQ;
+        } else qv = (qv<<6)|(v1&63);
+      }
+      if (qv >= 0x10FFFFL) {
+        return MMAPTWO_EILSEQ;
+      }
+      if (out != NULL) {
+        qv -= 0x10000;
+        out[n] = (wchar_t)(0xD800 | ((qv>>10)&1023));
+        out[n+1] = (wchar_t)(0xDC00 | (qv&1023));
+      }
+      n += 2;
+      p += 3;
+    } else {
+      return MMAPTWO_EILSEQ
+        /* since beyond U+10FFFF, no valid UTF-16 encoding */;
+    }
+  }
+  (*outlen) = n;
+  return 0;
+}
+
+wchar_t* mmaptwo_u8towc(unsigned char const* nm) {
+  /* use in-house wide character conversion */
+  size_t ns;
+  wchar_t* out;
   /* try the length */{
-    mbstate_t mbs;
-    wchar_t const* test_nm = nm;
-    memset(&mbs, 0, sizeof(mbs));
-    ns = wcsrtombs(NULL, &test_nm, 0, &mbs);
-  }
-  if (ns == (size_t)(-1)
-  ||  ns == ~((size_t)0))
-  {
-    /* conversion error caused by bad sequence, so */return NULL;
+    int err = mmaptwo_u8towc_shim(nm, NULL, &ns);
+    if (err != 0) {
+      /* conversion error caused by bad sequence, so */return NULL;
+    }
   }
-  out = calloc(ns+1, sizeof(char));
-  if (out) {
-    mbstate_t mbs;
-    wchar_t const* test_nm = nm;
-    memset(&mbs, 0, sizeof(mbs));
-    wcsrtombs(out, &test_nm, ns+1, &mbs);
+  out = (wchar_t*)calloc(ns+1, sizeof(wchar_t));
+  if (out != NULL) {
+    mmaptwo_u8towc_shim(nm, out, &ns);
     out[ns] = 0;
   }
   return out;
-#else
-  /* no thread-safe version, so give up */
-  return NULL;
-#endif /*__STDC_VERSION__*/
 }
 
-int mmaptwo_mode_rw_cvt(int mmode) {
-#if (defined O_CLOEXEC)
-  int const fast_no_bequeath = (int)(O_CLOEXEC);
+size_t mmaptwo_file_size_e(HANDLE fd) {
+  LARGE_INTEGER sz;
+  BOOL res = GetFileSizeEx(fd, &sz);
+  if (res) {
+#if (defined ULLONG_MAX)
+    return (size_t)sz.QuadPart;
 #else
-  int const fast_no_bequeath = 0;
-#endif /*O_CLOEXEC*/
+    return ((size_t)sz.u.LowPart)
+      |    (((size_t)sz.u.HighPart)<<32);
+#endif /*ULLONG_MAX*/
+  } else return 0u;
+}
+
+DWORD mmaptwo_mode_prot_cvt(int mmode) {
   switch (mmode) {
   case mmaptwo_mode_write:
-    return O_RDWR|fast_no_bequeath;
+    return PAGE_READWRITE;
   case mmaptwo_mode_read:
-    return O_RDONLY|fast_no_bequeath;
+    return PAGE_READONLY;
   default:
     return 0;
   }
 }
 
-int mmaptwo_mode_prot_cvt(int mmode) {
-  switch (mmode) {
+DWORD mmaptwo_mode_access_cvt(struct mmaptwo_mode_tag const mt) {
+  DWORD flags = 0;
+  switch (mt.mode) {
   case mmaptwo_mode_write:
-    return PROT_WRITE|PROT_READ;
+    flags = FILE_MAP_READ|FILE_MAP_WRITE;
+    break;
   case mmaptwo_mode_read:
-    return PROT_READ;
+    flags = FILE_MAP_READ;
+    break;
   default:
     return 0;
   }
-}
-
-int mmaptwo_mode_flag_cvt(int mprivy) {
-  return mprivy ? MAP_PRIVATE : MAP_SHARED;
-}
-
-size_t mmaptwo_file_size_e(int fd) {
-  struct stat fsi;
-  memset(&fsi, 0, sizeof(fsi));
-  /* stat pull */{
-    int const res = fstat(fd, &fsi);
-    if (res != 0) {
-      return 0u;
-    } else return (size_t)(fsi.st_size);
+  if (mt.privy) {
+    flags |= FILE_MAP_COPY;
   }
+  return flags;
 }
 
 struct mmaptwo_i* mmaptwo_open_rest
-  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+  (HANDLE fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
 {
-  struct mmaptwo_unix *const out = calloc(1, sizeof(struct mmaptwo_unix));
+  /*
+   * based on
+   * https://docs.microsoft.com/en-us/windows/win32/memory/
+   *   creating-a-view-within-a-file
+   */
+  struct mmaptwo_win32 *const out = calloc(1, sizeof(struct mmaptwo_win32));
+  void *ptr;
+  size_t fullsize;
+  size_t fullshift;
+  size_t fulloff;
+  size_t extended_size;
+  size_t const size_clamp = mmaptwo_file_size_e(fd);
+  HANDLE fmd;
+  SECURITY_ATTRIBUTES cfmsa;
   if (out == NULL) {
-    close(fd);
+    CloseHandle(fd);
     return NULL;
   }
-  /* assign the close-on-exec flag */{
-    int const old_flags = fcntl(fd, F_GETFD);
-    int bequeath_break = 0;
-    if (old_flags < 0) {
-      bequeath_break = 1;
-    } else if (mt.bequeath) {
-      bequeath_break = (fcntl(fd, F_SETFD, old_flags&(~FD_CLOEXEC)) < 0);
+  if (mt.end) /* fix map size */{
+    size_t const xsz = size_clamp;
+    if (xsz < off) {
+      /* reject non-ending zero parameter */
+      CloseHandle(fd);
+      free(out);
+      errno = ERANGE;
+      return NULL;
+    } else sz = xsz-off;
+  } else if (sz == 0) {
+    /* reject non-ending zero parameter */
+    CloseHandle(fd);
+    free(out);
+#if (defined EINVAL)
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif /*EINVAL*/
+    return NULL;
+  }
+  /* fix to allocation granularity */{
+    DWORD psize;
+    /* get the allocation granularity */{
+      SYSTEM_INFO s_info;
+      GetSystemInfo(&s_info);
+      psize = s_info.dwAllocationGranularity;
+    }
+    fullsize = sz;
+    if (psize > 0) {
+      /* adjust the offset */
+      fullshift = off;
+      fulloff = (off-fullshift);
+      if (fullshift >= ((~(size_t)0u)-sz)) {
+        /* range fix failure */
+        CloseHandle(fd);
+        free(out);
+        errno = ERANGE;
+        return NULL;
+      } else fullsize += fullshift;
+      /* adjust the size */{
+        size_t size_shift = (fullsize % psize);
+        if (size_shift > 0) {
+          extended_size = fullsize + (psize - size_shift);
+        } else extended_size = fullsize;
+      }
     } else {
-      bequeath_break = (fcntl(fd, F_SETFD, old_flags|FD_CLOEXEC) < 0);
+      fulloff = off;
+      fullshift = 0u;
+      extended_size = sz;
     }
-    if (bequeath_break) {
-      close(fd);
+  }
+  /* prepare the security attributes */{
+    memset(&cfmsa, 0, sizeof(cfmsa));
+    cfmsa.nLength = sizeof(cfmsa);
+    cfmsa.lpSecurityDescriptor = NULL;
+    cfmsa.bInheritHandle = (BOOL)(mt.bequeath ? TRUE : FALSE);
+  }
+  /* check for potential overflow */{
+    if (fulloff >= ((~(size_t)0u)-extended_size)) {
+      /* range fix failure */
+      CloseHandle(fd);
       free(out);
+      errno = ERANGE;
       return NULL;
     }
   }
-  if (mt.end) /* fix map size */{
-    size_t const xsz = mmaptwo_file_size_e(fd);
-    if (xsz < off)
-      sz = 0 /*to fail*/;
-    else sz = xsz-off;
+  /* create the file mapping object */{
+    /*
+     * clamp size to end of file;
+     * based on https://stackoverflow.com/a/46014637
+     */
+    size_t const fullextent = size_clamp > extended_size+fulloff
+        ? extended_size + fulloff
+        : size_clamp;
+    fmd = CreateFileMappingA(
+        fd, /*hFile*/
+        &cfmsa, /*lpFileMappingAttributes*/
+        mmaptwo_mode_prot_cvt(mt.mode), /*flProtect*/
+        (DWORD)((fullextent>>32)&0xFFffFFff), /*dwMaximumSizeHigh*/
+        (DWORD)(fullextent&0xFFffFFff), /*dwMaximumSizeLow*/
+        NULL /*lpName*/
+      );
   }
-  if (sz == 0)/* then fail */ {
-    close(fd);
+  if (fmd == NULL) {
+    /* file mapping failed */
+    CloseHandle(fd);
     free(out);
-    errno = ERANGE;
     return NULL;
   }
   /* initialize the interface */{
-    out->len = sz;
+    out->len = fullsize;
     out->fd = fd;
+    out->fmd = fmd;
     out->offnum = off;
     out->mt = mt;
     out->base.mmt_dtor = &mmaptwo_mmt_dtor;
@@ -470,45 +5041,24 @@ struct mmaptwo_i* mmaptwo_open_rest
   return (struct mmaptwo_i*)out;
 }
 
-void mmaptwo_mmt_dtor(struct mmaptwo_i* m) {
-  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
-  close(mu->fd);
-  mu->fd = -1;
-  free(mu);
-  return;
-}
-
-void mmaptwo_mmtp_dtor(struct mmaptwo_page_i* p) {
-  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
-  munmap(pu->ptr, pu->len);
-  pu->ptr = NULL;
-  free(pu);
-  return;
-}
-
-void* mmaptwo_mmtp_get(struct mmaptwo_page_i* p) {
-  struct mmaptwo_page_unix* const pu = (struct mmaptwo_page_unix*)p;
-  return ((unsigned char*)pu->ptr)+pu->shift;
-}
-void const* mmaptwo_mmtp_getconst(struct mmaptwo_page_i const* p) {
-  struct mmaptwo_page_unix const* const pu =
-    (struct mmaptwo_page_unix const*)p;
-  return ((unsigned char const*)pu->ptr)+pu->shift;
-}
-
 struct mmaptwo_page_i* mmaptwo_mmt_acquire
   (struct mmaptwo_i* m, size_t sz, size_t pre_off)
 {
-  struct mmaptwo_unix* const mu = (struct mmaptwo_unix*)m;
-  size_t off;
-  struct mmaptwo_page_unix* out;
+  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
+  struct mmaptwo_page_win32* out;
   size_t fullsize;
+  size_t off;
   size_t fullshift;
   void *ptr;
-  off_t fulloff;
+  size_t fulloff;
+  out = calloc(1, sizeof(struct mmaptwo_page_win32));
+  if (out == NULL) {
+    return NULL;
+  }
   /* repair input size and offset */{
-    if (pre_off > mu->len
-    ||  sz > mu->len - pre_off
+    size_t const shifted_len = mu->len - mu->offnum;
+    if (pre_off > shifted_len
+    ||  sz > shifted_len - pre_off
     ||  sz == 0u)
     {
       errno = EDOM;
@@ -516,17 +5066,18 @@ struct mmaptwo_page_i* mmaptwo_mmt_acquire
     }
     off = pre_off + mu->offnum;
   }
-  out = calloc(1,sizeof(struct mmaptwo_page_unix));
-  if (out == NULL) {
-    /* give up, and */return NULL;
-  }
-  /* fix to page sizes */{
-    long const psize = sysconf(_SC_PAGE_SIZE);
+  /* compute new offsets */{
+    DWORD psize;
+    /* get the allocation granularity */{
+      SYSTEM_INFO s_info;
+      GetSystemInfo(&s_info);
+      psize = s_info.dwAllocationGranularity;
+    }
     fullsize = sz;
     if (psize > 0) {
       /* adjust the offset */
-      fullshift = off%((unsigned long)psize);
-      fulloff = (off_t)(off-fullshift);
+      fullshift = off%psize;
+      fulloff = (off-fullshift);
       if (fullshift >= ((~(size_t)0u)-sz)) {
         /* range fix failure */
         free(out);
@@ -534,453 +5085,1111 @@ struct mmaptwo_page_i* mmaptwo_mmt_acquire
         return NULL;
       } else fullsize += fullshift;
     } else {
-      fulloff = (off_t)off;
+      fulloff = off;
       fullshift = 0u;
     }
   }
-  ptr = mmap(NULL, fullsize, mmaptwo_mode_prot_cvt(mu->mt.mode),
-       mmaptwo_mode_flag_cvt(mu->mt.privy), mu->fd, fulloff);
-  if (ptr == MAP_FAILED) {
+  ptr = MapViewOfFile(
+      mu->fmd, /*hFileMappingObject*/
+      mmaptwo_mode_access_cvt(mu->mt), /*dwDesiredAccess*/
+      (DWORD)((fulloff>>32)&0xFFffFFff), /* dwFileOffsetHigh */
+      (DWORD)(fulloff&0xFFffFFff), /* dwFileOffsetLow */
+      (SIZE_T)(fullsize) /* dwNumberOfBytesToMap */
+    );
+  if (ptr == NULL) {
     free(out);
     return NULL;
   }
   /* initialize the interface */{
     out->ptr = ptr;
     out->len = fullsize;
-    out->shift = fullshift;
     out->offnum = pre_off;
+    out->shift = fullshift;
     out->base.mmtp_dtor = &mmaptwo_mmtp_dtor;
     out->base.mmtp_get = &mmaptwo_mmtp_get;
     out->base.mmtp_getconst = &mmaptwo_mmtp_getconst;
-    out->base.mmtp_offset = &mmaptwo_mmtp_offset;
     out->base.mmtp_length = &mmaptwo_mmtp_length;
+    out->base.mmtp_offset = &mmaptwo_mmtp_offset;
   }
   return (struct mmaptwo_page_i*)out;
 }
 
-size_t mmaptwo_mmt_length(struct mmaptwo_i const* m) {
-  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
-  return mu->len;
+void mmaptwo_mmtp_dtor(struct mmaptwo_page_i* m) {
+  struct mmaptwo_page_win32* const mu = (struct mmaptwo_page_win32*)m;
+  UnmapViewOfFile(mu->ptr);
+  mu->ptr = NULL;
+  free(mu);
+  return;
 }
 
-size_t mmaptwo_mmtp_length(struct mmaptwo_page_i const* p) {
-  struct mmaptwo_page_unix const* const pu =
-    (struct mmaptwo_page_unix const*)p;
-  return pu->len-pu->shift;
+void mmaptwo_mmt_dtor(struct mmaptwo_i* m) {
+  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
+  CloseHandle(mu->fmd);
+  mu->fmd = NULL;
+  CloseHandle(mu->fd);
+  mu->fd = NULL;
+  free(mu);
+  return;
 }
 
 size_t mmaptwo_mmt_offset(struct mmaptwo_i const* m) {
-  struct mmaptwo_unix const* const mu = (struct mmaptwo_unix const*)m;
+  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
+  return mu->offnum;
+}
+size_t mmaptwo_mmtp_offset(struct mmaptwo_page_i const* m) {
+  struct mmaptwo_page_win32* const mu = (struct mmaptwo_page_win32*)m;
   return mu->offnum;
 }
 
-size_t mmaptwo_mmtp_offset(struct mmaptwo_page_i const* p) {
-  struct mmaptwo_page_unix const* const pu =
-    (struct mmaptwo_page_unix const*)p;
-  return pu->offnum;
+size_t mmaptwo_mmt_length(struct mmaptwo_i const* m) {
+  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
+  return mu->len-mu->offnum;
 }
-#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
-DWORD mmaptwo_mode_rw_cvt(int mmode) {
-  switch (mmode) {
-  case mmaptwo_mode_write:
-    return GENERIC_READ|GENERIC_WRITE;
-  case mmaptwo_mode_read:
-    return GENERIC_READ;
-  default:
-    return 0;
+size_t mmaptwo_mmtp_length(struct mmaptwo_page_i const* m) {
+  struct mmaptwo_page_win32* const mu = (struct mmaptwo_page_win32*)m;
+  return mu->len-mu->shift;
+}
+
+void* mmaptwo_mmtp_get(struct mmaptwo_page_i* p) {
+  struct mmaptwo_page_win32* const pu = (struct mmaptwo_page_win32*)p;
+  return ((unsigned char*)pu->ptr)+pu->shift;
+}
+void const* mmaptwo_mmtp_getconst(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_page_win32 const* const pu =
+    (struct mmaptwo_page_win32 const*)p;
+  return ((unsigned char const*)pu->ptr)+pu->shift;
+}
+#endif /*MMAPTWO_OS*/
+
+#if MMAPTWO_OS != MMAPTWO_OS_WIN32
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+struct mmaptwo_i* mmaptwo_buf_make
+  (int io, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+#else
+struct mmaptwo_i* mmaptwo_buf_make
+  (FILE* io, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+#endif /*MMAPTWO_OS*/
+{
+  struct mmaptwo_buf *const out = calloc(1, sizeof(struct mmaptwo_buf));
+  if (out == NULL) {
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+    close(io);
+#else
+    fclose(io);
+#endif /*MMAPTWO_OS*/
+    return NULL;
   }
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  out->fd = io;
+  pthread_mutex_init(&out->grow_lock, NULL);
+  out->base.mmt_extend = &mmaptwo_bufm_extend;
+  out->base.mmt_fd = &mmaptwo_bufm_fd;
+  out->base.mmt_residency = &mmaptwo_bufm_residency;
+#else
+  out->fp = io;
+#endif /*MMAPTWO_OS*/
+  out->mt = mt;
+  out->offnum = off;
+  out->len = sz;
+  out->refs = 1u;
+  out->max = (size_t)(MMAPTWO_BUF_CACHE);
+  out->base.mmt_dtor = &mmaptwo_bufm_dtor;
+  out->base.mmt_acquire = &mmaptwo_bufm_acquire;
+  out->base.mmt_length = &mmaptwo_bufm_length;
+  out->base.mmt_offset = &mmaptwo_bufm_offset;
+  out->base.mmt_set_cache = &mmaptwo_bufm_set_cache;
+  out->base.mmt_cache_stats = &mmaptwo_bufm_cache_stats;
+  out->base.mmt_acquire_flags = &mmaptwo_bufm_acquire_flags;
+  out->base.mmt_stats = &mmaptwo_bufm_stats;
+  return (struct mmaptwo_i*)out;
 }
 
-DWORD mmaptwo_mode_disposition_cvt(int mmode) {
-  switch (mmode) {
-  case mmaptwo_mode_write:
-    return OPEN_ALWAYS;
-  case mmaptwo_mode_read:
-    return OPEN_EXISTING;
-  default:
-    return 0;
+void mmaptwo_buf_release(struct mmaptwo_buf* b) {
+  if (mmaptwo_atomic_add(&b->refs, ~(size_t)0u) == 0u) {
+    mmaptwo_buf_drop(mmaptwo_buf_trim(b, 0u));
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+    close(b->fd);
+    pthread_mutex_destroy(&b->grow_lock);
+#else
+    fclose(b->fp);
+#endif /*MMAPTWO_OS*/
+    free(b);
   }
+  return;
 }
 
-int mmaptwo_u8towc_shim
-  (unsigned char const* nm, wchar_t* out, size_t* outlen)
+int mmaptwo_buf_read
+  ( struct mmaptwo_buf* b, unsigned char* dst, size_t sz, size_t off,
+    size_t* got)
 {
-  size_t n = 0;
-  unsigned char const* p;
-  static size_t const sz_max = UINT_MAX/2u-4u;
-  for (p = nm; *p && n < sz_max; ++p) {
-    unsigned char const v = *p;
-    if (n >= sz_max) {
-      return ERANGE;
+  size_t n = 0u;
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  while (n < sz) {
+    ssize_t const res = pread(b->fd, dst+n, sz-n, (off_t)(off+n));
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      *got = n;
+      return errno;
+    } else if (res == 0) {
+      /* end of file */break;
     }
-    if (v < 0x80) {
-      /* Latin-1 compatibility */
-      if (out != NULL) {
-        out[n] = v;
-      }
-      n += 1;
-    } else if (v < 0xC0) {
-      return MMAPTWO_EILSEQ;
-    } else if (v < 0xE0) {
-      /* check extension codes */
-      unsigned int i;
-      unsigned long int qv = v&31;
-      for (i = 0; i < 1; ++i) {
-        unsigned char const v1 = *(p+i);
-        if (v1 < 0x80 || v1 >= 0xC0) {
-          return MMAPTWO_EILSEQ;
-        } else qv = (qv<<6)|(v1&63);
-      }
-      if (out != NULL) {
-        out[n] = (wchar_t)qv;
-      }
-      n += 1;
-      p += 1;
-    } else if (v < 0xF0) {
-      /* check extension codes */
-      unsigned int i;
-      unsigned long int qv = v&15;
-      for (i = 0; i < 2; ++i) {
-        unsigned char const v1 = *(p+i);
-        if (v1 < 0x80 || v1 >= 0xC0) {
-          return MMAPTWO_EILSEQ;
-        } else qv = (qv<<6)|(v1&63);
+    n += (size_t)res;
+  }
+#else
+  if (off > (unsigned long)LONG_MAX) {
+    *got = 0u;
+    return ERANGE;
+  }
+  mmaptwo_spin_lock(&b->io_lock);
+  if (fseek(b->fp, (long)off, SEEK_SET) != 0) {
+    mmaptwo_spin_unlock(&b->io_lock);
+    *got = 0u;
+    return ERANGE;
+  }
+  n = fread(dst, 1u, sz, b->fp);
+  if (n < sz && ferror(b->fp)) {
+    clearerr(b->fp);
+    mmaptwo_spin_unlock(&b->io_lock);
+    *got = n;
+    return EDOM;
+  }
+  mmaptwo_spin_unlock(&b->io_lock);
+#endif /*MMAPTWO_OS*/
+  *got = n;
+  return 0;
+}
+
+int mmaptwo_buf_write
+  (struct mmaptwo_buf* b, unsigned char const* src, size_t sz, size_t off)
+{
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  size_t n = 0u;
+  while (n < sz) {
+    ssize_t const res = pwrite(b->fd, src+n, sz-n, (off_t)(off+n));
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    n += (size_t)res;
+  }
+  return 0;
+#else
+  int res = 0;
+  if (off > (unsigned long)LONG_MAX) {
+    return ERANGE;
+  }
+  mmaptwo_spin_lock(&b->io_lock);
+  if (fseek(b->fp, (long)off, SEEK_SET) != 0) {
+    res = ERANGE;
+  } else if (fwrite(src, 1u, sz, b->fp) != sz) {
+    clearerr(b->fp);
+    res = EDOM;
+  }
+  mmaptwo_spin_unlock(&b->io_lock);
+  return res;
+#endif /*MMAPTWO_OS*/
+}
+
+int mmaptwo_buf_fill
+  (struct mmaptwo_buf* b, unsigned char* dst, size_t sz, size_t off)
+{
+  size_t const bsz = (size_t)(MMAPTWO_BUF_BLOCK);
+  while (sz > 0u) {
+    size_t const boff = off - off%bsz;
+    size_t const lead = off-boff;
+    size_t const step = (sz < bsz-lead) ? sz : bsz-lead;
+    struct mmaptwo_buf_block* blk;
+    struct mmaptwo_buf_block* dropped = NULL;
+    struct mmaptwo_buf_block* fresh = NULL;
+    size_t gen;
+    int res;
+    mmaptwo_spin_lock(&b->lock);
+    for (blk = b->head; blk != NULL; blk = blk->next) {
+      if (blk->off == boff)
+        break;
+    }
+    if (blk != NULL) {
+      b->hits += 1u;
+    } else {
+      b->misses += 1u;
+      gen = b->gen;
+      mmaptwo_spin_unlock(&b->lock);
+      /* read the whole block outside of the lock */
+      fresh = malloc(sizeof(struct mmaptwo_buf_block));
+      if (fresh == NULL) {
+        return MMAPTWO_ENOMEM;
       }
-      if (out != NULL) {
-        out[n] = (wchar_t)qv;
+      fresh->data = malloc(bsz);
+      if (fresh->data == NULL) {
+        free(fresh);
+        return MMAPTWO_ENOMEM;
       }
-      n += 1;
-      p += 2;
-    } else if (v < 0xF8) {
-      /* check extension codes */
-      unsigned int i;
-      unsigned long int qv = v&3;
-      for (i = 0; i < 3; ++i) {
-        unsigned char const v1 = *(p+i);
-        if (v1 < 0x80 || v1 >= 0xC0) {
-          return MMAPTWO_EILSEQ;
-        } else qv = (qv<<6)|(v1&63);
+      fresh->off = boff;
+      fresh->prev = NULL;
+      fresh->next = NULL;
+      res = mmaptwo_buf_read(b, fresh->data, bsz, boff, &fresh->len);
+      if (res != 0) {
+        mmaptwo_buf_drop(fresh);
+        return res;
       }
-      if (qv >= 0x10FFFFL) {
-        return MMAPTWO_EILSEQ;
+      mmaptwo_spin_lock(&b->lock);
+      /* another page may have read the same block meanwhile */
+      for (blk = b->head; blk != NULL; blk = blk->next) {
+        if (blk->off == boff)
+          break;
       }
-      if (out != NULL) {
-        qv -= 0x10000;
-        out[n] = (wchar_t)(0xD800 | ((qv>>10)&1023));
-        out[n+1] = (wchar_t)(0xDC00 | (qv&1023));
+      if (blk == NULL && b->max >= bsz && b->gen == gen) {
+        blk = fresh;
+        fresh = NULL;
+        blk->next = b->head;
+        if (b->head != NULL)
+          b->head->prev = blk;
+        else b->tail = blk;
+        b->head = blk;
+        b->bytes += bsz;
+        dropped = mmaptwo_buf_trim(b, b->max);
       }
-      n += 2;
-      p += 3;
-    } else {
-      return MMAPTWO_EILSEQ
-        /* since beyond U+10FFFF, no valid UTF-16 encoding */;
     }
+    if (blk == NULL) {
+      /* the block stays out of the cache, so copy from it directly */
+      blk = fresh;
+    } else if (blk != b->head) {
+      /* mark as most recently used */
+      blk->prev->next = blk->next;
+      if (blk->next != NULL)
+        blk->next->prev = blk->prev;
+      else b->tail = blk->prev;
+      blk->prev = NULL;
+      blk->next = b->head;
+      b->head->prev = blk;
+      b->head = blk;
+    }
+    /* copy, zero-filling past the end of file */{
+      size_t const avail = (blk->len > lead) ? blk->len-lead : 0u;
+      size_t const n = (avail < step) ? avail : step;
+      memcpy(dst, blk->data+lead, n);
+      memset(dst+n, 0, step-n);
+    }
+    mmaptwo_spin_unlock(&b->lock);
+    mmaptwo_buf_drop(dropped);
+    mmaptwo_buf_drop(fresh);
+    dst += step;
+    off += step;
+    sz -= step;
   }
-  (*outlen) = n;
   return 0;
 }
 
-wchar_t* mmaptwo_u8towc(unsigned char const* nm) {
-  /* use in-house wide character conversion */
-  size_t ns;
-  wchar_t* out;
-  /* try the length */{
-    int err = mmaptwo_u8towc_shim(nm, NULL, &ns);
-    if (err != 0) {
-      /* conversion error caused by bad sequence, so */return NULL;
+int mmaptwo_buf_store
+  (struct mmaptwo_buf* b, unsigned char const* src, size_t sz, size_t off)
+{
+  int const res = mmaptwo_buf_write(b, src, sz, off);
+  struct mmaptwo_buf_block* blk;
+  if (res != 0) {
+    return res;
+  }
+  /* keep cached blocks in step with the file */
+  mmaptwo_spin_lock(&b->lock);
+  b->gen += 1u;
+  for (blk = b->head; blk != NULL; blk = blk->next) {
+    size_t const bend = blk->off + (size_t)(MMAPTWO_BUF_BLOCK);
+    size_t lo;
+    size_t hi;
+    if (off >= bend || off+sz <= blk->off)
+      continue;
+    lo = (off > blk->off) ? off : blk->off;
+    hi = (off+sz < bend) ? off+sz : bend;
+    if (blk->len < lo-blk->off) {
+      /* the write left a hole, which reads back as zeros */
+      memset(blk->data+blk->len, 0, lo-blk->off-blk->len);
     }
+    memcpy(blk->data+(lo-blk->off), src+(lo-off), hi-lo);
+    if (blk->len < hi-blk->off)
+      blk->len = hi-blk->off;
   }
-  out = (wchar_t*)calloc(ns+1, sizeof(wchar_t));
-  if (out != NULL) {
-    mmaptwo_u8towc_shim(nm, out, &ns);
-    out[ns] = 0;
+  mmaptwo_spin_unlock(&b->lock);
+  return 0;
+}
+
+struct mmaptwo_buf_block* mmaptwo_buf_trim
+  (struct mmaptwo_buf* b, size_t max)
+{
+  struct mmaptwo_buf_block* out = NULL;
+  while (b->bytes > max) {
+    struct mmaptwo_buf_block* const blk = b->tail;
+    b->tail = blk->prev;
+    if (b->tail != NULL)
+      b->tail->next = NULL;
+    else b->head = NULL;
+    b->bytes -= (size_t)(MMAPTWO_BUF_BLOCK);
+    b->evictions += 1u;
+    blk->prev = NULL;
+    blk->next = out;
+    out = blk;
   }
   return out;
 }
 
-size_t mmaptwo_file_size_e(HANDLE fd) {
-  LARGE_INTEGER sz;
-  BOOL res = GetFileSizeEx(fd, &sz);
-  if (res) {
-#if (defined ULLONG_MAX)
-    return (size_t)sz.QuadPart;
+void mmaptwo_buf_drop(struct mmaptwo_buf_block* blk) {
+  while (blk != NULL) {
+    struct mmaptwo_buf_block* const next = blk->next;
+    free(blk->data);
+    free(blk);
+    blk = next;
+  }
+  return;
+}
+
+void mmaptwo_bufm_dtor(struct mmaptwo_i* m) {
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  struct mmaptwo_buf_block* dropped;
+  /* open pages write back without the cache */
+  mmaptwo_spin_lock(&b->lock);
+  b->max = 0u;
+  dropped = mmaptwo_buf_trim(b, 0u);
+  mmaptwo_spin_unlock(&b->lock);
+  mmaptwo_buf_drop(dropped);
+  mmaptwo_buf_release(b);
+  return;
+}
+
+struct mmaptwo_page_i* mmaptwo_bufm_acquire
+  (struct mmaptwo_i* m, size_t sz, size_t off)
+{
+  return mmaptwo_bufm_acquire_flags(m, sz, off, 0);
+}
+
+struct mmaptwo_page_i* mmaptwo_bufm_acquire_flags
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags)
+{
+  struct mmaptwo_page_i* const out =
+    mmaptwo_bufm_acquire_copy(m, sz, off, flags);
+  if (out == NULL) {
+    int const err = errno;
+    mmaptwo_stat_fail(&((struct mmaptwo_buf*)m)->stats, err);
+    errno = err;
+  }
+  return out;
+}
+
+struct mmaptwo_page_i* mmaptwo_bufm_acquire_copy
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags)
+{
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  struct mmaptwo_buf_page* out;
+  int res;
+  /* repair input size and offset */{
+    size_t const len = mmaptwo_atomic_get(&b->len);
+    if (off > len
+    ||  sz > len - off
+    ||  sz == 0u)
+    {
+      errno = EDOM;
+      return NULL;
+    }
+  }
+  if (flags & mmaptwo_acquire_resident) {
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+    res = mmaptwo_file_resident(b->fd, b->offnum+off, sz);
 #else
-    return ((size_t)sz.u.LowPart)
-      |    (((size_t)sz.u.HighPart)<<32);
-#endif /*ULLONG_MAX*/
-  } else return 0u;
+    res = MMAPTWO_ENOSYS;
+#endif /*MMAPTWO_OS*/
+    if (res != 0) {
+      errno = res;
+      return NULL;
+    }
+  }
+  out = calloc(1, sizeof(struct mmaptwo_buf_page));
+  if (out == NULL) {
+    return NULL;
+  }
+  out->data = malloc(sz);
+  if (out->data == NULL) {
+    free(out);
+    return NULL;
+  }
+  res = mmaptwo_buf_fill(b, out->data, sz, b->offnum+off);
+  if (res != 0) {
+    free(out->data);
+    free(out);
+    errno = res;
+    return NULL;
+  }
+  out->len = sz;
+  out->offnum = off;
+  out->src = b;
+  mmaptwo_atomic_add(&b->refs, 1u);
+  mmaptwo_stat_acquire(&b->stats);
+  out->base.mmtp_dtor = &mmaptwo_bufp_dtor;
+  out->base.mmtp_get = &mmaptwo_bufp_get;
+  out->base.mmtp_getconst = &mmaptwo_bufp_getconst;
+  out->base.mmtp_length = &mmaptwo_bufp_length;
+  out->base.mmtp_offset = &mmaptwo_bufp_offset;
+  out->base.mmtp_flush = &mmaptwo_bufp_flush;
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  out->base.mmtp_residency = &mmaptwo_bufp_residency;
+#endif /*MMAPTWO_OS*/
+  return (struct mmaptwo_page_i*)out;
 }
 
-DWORD mmaptwo_mode_prot_cvt(int mmode) {
-  switch (mmode) {
-  case mmaptwo_mode_write:
-    return PAGE_READWRITE;
-  case mmaptwo_mode_read:
-    return PAGE_READONLY;
-  default:
-    return 0;
+size_t mmaptwo_bufm_length(struct mmaptwo_i const* m) {
+  struct mmaptwo_buf const* const b = (struct mmaptwo_buf const*)m;
+  return mmaptwo_atomic_get(&b->len);
+}
+
+size_t mmaptwo_bufm_offset(struct mmaptwo_i const* m) {
+  struct mmaptwo_buf const* const b = (struct mmaptwo_buf const*)m;
+  return b->offnum;
+}
+
+int mmaptwo_bufm_set_cache(struct mmaptwo_i* m, size_t max) {
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  struct mmaptwo_buf_block* dropped;
+  mmaptwo_spin_lock(&b->lock);
+  b->max = max;
+  dropped = mmaptwo_buf_trim(b, max);
+  mmaptwo_spin_unlock(&b->lock);
+  mmaptwo_buf_drop(dropped);
+  return 0;
+}
+
+int mmaptwo_bufm_cache_stats
+  (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st)
+{
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  mmaptwo_spin_lock(&b->lock);
+  st->hits = b->hits;
+  st->misses = b->misses;
+  st->evictions = b->evictions;
+  st->bytes = b->bytes;
+  st->max = b->max;
+  mmaptwo_spin_unlock(&b->lock);
+  return 0;
+}
+
+int mmaptwo_bufm_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset)
+{
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  return mmaptwo_stat_read(&b->stats, st, reset);
+}
+
+void mmaptwo_bufp_dtor(struct mmaptwo_page_i* p) {
+  struct mmaptwo_buf_page* const bp = (struct mmaptwo_buf_page*)p;
+  struct mmaptwo_buf* const b = bp->src;
+  mmaptwo_stat_release(&b->stats);
+  if (bp->dirty && b->mt.mode == mmaptwo_mode_write && !b->mt.privy) {
+    /* write back; the destructor has no way to report failure */
+    mmaptwo_buf_store(b, bp->data, bp->len, b->offnum+bp->offnum);
   }
+  free(bp->data);
+  free(bp);
+  mmaptwo_buf_release(b);
+  return;
 }
 
-DWORD mmaptwo_mode_access_cvt(struct mmaptwo_mode_tag const mt) {
-  DWORD flags = 0;
-  switch (mt.mode) {
-  case mmaptwo_mode_write:
-    flags = FILE_MAP_READ|FILE_MAP_WRITE;
-    break;
-  case mmaptwo_mode_read:
-    flags = FILE_MAP_READ;
-    break;
-  default:
+void* mmaptwo_bufp_get(struct mmaptwo_page_i* p) {
+  struct mmaptwo_buf_page* const bp = (struct mmaptwo_buf_page*)p;
+  bp->dirty = 1;
+  return bp->data;
+}
+
+void const* mmaptwo_bufp_getconst(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_buf_page const* const bp =
+    (struct mmaptwo_buf_page const*)p;
+  return bp->data;
+}
+
+size_t mmaptwo_bufp_length(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_buf_page const* const bp =
+    (struct mmaptwo_buf_page const*)p;
+  return bp->len;
+}
+
+size_t mmaptwo_bufp_offset(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_buf_page const* const bp =
+    (struct mmaptwo_buf_page const*)p;
+  return bp->offnum;
+}
+
+int mmaptwo_bufp_flush
+  (struct mmaptwo_page_i* p, size_t sz, size_t off, int flags)
+{
+  struct mmaptwo_buf_page* const bp = (struct mmaptwo_buf_page*)p;
+  struct mmaptwo_buf* const b = bp->src;
+  int res;
+  if (off > bp->len || sz > bp->len-off) {
+    return EDOM;
+  }
+  if (sz == 0u || b->mt.privy || b->mt.mode != mmaptwo_mode_write) {
+    /* nothing can reach the file */
     return 0;
   }
-  if (mt.privy) {
-    flags |= FILE_MAP_COPY;
+  res = mmaptwo_buf_store(b, bp->data+off, sz, b->offnum+bp->offnum+off);
+  if (res != 0) {
+    return res;
+  } else if (off == 0u && sz == bp->len) {
+    /* the file now holds the whole copy */
+    bp->dirty = 0;
   }
-  return flags;
+  if (flags & mmaptwo_flush_async) {
+    return 0;
+  }
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  return fdatasync(b->fd) != 0 ? errno : 0;
+#else
+  mmaptwo_spin_lock(&b->io_lock);
+  res = (fflush(b->fp) != 0) ? EDOM : 0;
+  mmaptwo_spin_unlock(&b->io_lock);
+  return res;
+#endif /*MMAPTWO_OS*/
 }
 
-struct mmaptwo_i* mmaptwo_open_rest
-  (HANDLE fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+int mmaptwo_bufm_extend(struct mmaptwo_i* m, size_t sz) {
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  size_t end;
+  int res = 0;
+  if (sz > (~(size_t)0u)-b->offnum) {
+    return ERANGE;
+  }
+  end = b->offnum+sz;
+  pthread_mutex_lock(&b->grow_lock);
+  if (sz > mmaptwo_atomic_get(&b->len)) {
+    size_t const cur = mmaptwo_file_size_e(b->fd);
+    if (cur < end) {
+      /* pages write back by offset, so only the length must reach */
+      res = (b->mt.mode != mmaptwo_mode_write)
+        ? EBADF : mmaptwo_file_grow(b->fd, cur, end);
+    }
+    if (res == 0) {
+      mmaptwo_atomic_set(&b->len, sz);
+    }
+  }
+  pthread_mutex_unlock(&b->grow_lock);
+  return res;
+}
+
+int mmaptwo_bufm_fd(struct mmaptwo_i const* m) {
+  struct mmaptwo_buf const* const b = (struct mmaptwo_buf const*)m;
+  return b->fd;
+}
+
+int mmaptwo_bufm_residency
+  ( struct mmaptwo_i* m, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident)
 {
-  /*
-   * based on
-   * https://docs.microsoft.com/en-us/windows/win32/memory/
-   *   creating-a-view-within-a-file
-   */
-  struct mmaptwo_win32 *const out = calloc(1, sizeof(struct mmaptwo_win32));
-  void *ptr;
-  size_t fullsize;
-  size_t fullshift;
-  size_t fulloff;
-  size_t extended_size;
-  size_t const size_clamp = mmaptwo_file_size_e(fd);
-  HANDLE fmd;
-  SECURITY_ATTRIBUTES cfmsa;
+  struct mmaptwo_buf* const b = (struct mmaptwo_buf*)m;
+  if (off > mmaptwo_atomic_get(&b->len)
+  ||  sz > mmaptwo_atomic_get(&b->len)-off)
+  {
+    return EDOM;
+  }
+  return mmaptwo_file_residency(b->fd, b->offnum+off, sz, bits, resident);
+}
+
+int mmaptwo_bufp_residency
+  ( struct mmaptwo_page_i* p, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident)
+{
+  struct mmaptwo_buf_page* const bp = (struct mmaptwo_buf_page*)p;
+  size_t const psize = (size_t)sysconf(_SC_PAGE_SIZE);
+  size_t const lead = ((size_t)bp->data)%psize;
+  if (off > bp->len || sz > bp->len-off) {
+    return EDOM;
+  }
+  return mmaptwo_mincore(bp->data-lead, lead+off, sz, bits, resident);
+}
+#endif /*MMAPTWO_OS*/
+#endif /*MMAPTWO_OS*/
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX && MMAPTWO_URING
+struct mmaptwo_i* mmaptwo_uring_make
+  (int fd, struct mmaptwo_mode_tag const mt, size_t sz, size_t off)
+{
+  struct io_uring_params params;
+  struct mmaptwo_uring* out;
+  int ring;
+  memset(&params, 0, sizeof(params));
+  ring = (int)syscall(__NR_io_uring_setup,
+      (unsigned int)(MMAPTWO_URING_DEPTH), &params);
+  if (ring < 0) {
+    return NULL;
+  }
+  out = calloc(1, sizeof(struct mmaptwo_uring));
   if (out == NULL) {
-    CloseHandle(fd);
+    close(ring);
     return NULL;
   }
-  if (mt.end) /* fix map size */{
-    size_t const xsz = size_clamp;
-    if (xsz < off) {
-      /* reject non-ending zero parameter */
-      CloseHandle(fd);
-      free(out);
-      errno = ERANGE;
+  out->ring = ring;
+  out->sq_ptr = MAP_FAILED;
+  out->cq_ptr = MAP_FAILED;
+  out->sqes = MAP_FAILED;
+  out->arena = MAP_FAILED;
+  /* map the rings */{
+    out->sq_len = params.sq_off.array
+      + params.sq_entries*sizeof(unsigned int);
+    out->cq_len = params.cq_off.cqes
+      + params.cq_entries*sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      if (out->cq_len > out->sq_len)
+        out->sq_len = out->cq_len;
+      out->cq_len = 0u;
+    }
+    out->sq_ptr = mmap(NULL, out->sq_len, PROT_READ|PROT_WRITE,
+        MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    if (out->sq_ptr != MAP_FAILED) {
+      out->cq_ptr = (out->cq_len == 0u) ? out->sq_ptr
+        : mmap(NULL, out->cq_len, PROT_READ|PROT_WRITE,
+            MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    }
+    out->depth = params.sq_entries;
+    if (out->cq_ptr != MAP_FAILED) {
+      out->sqes = mmap(NULL,
+          params.sq_entries*sizeof(struct io_uring_sqe),
+          PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+          ring, IORING_OFF_SQES);
+    }
+    if (out->sqes != MAP_FAILED) {
+      out->arena = mmap(NULL,
+          (size_t)(MMAPTWO_URING_SLOTS)*(size_t)(MMAPTWO_URING_SLOT),
+          PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    }
+    if (out->arena == MAP_FAILED) {
+      int const err = errno;
+      mmaptwo_uring_free(out);
+      errno = err;
       return NULL;
-    } else sz = xsz-off;
-  } else if (sz == 0) {
-    /* reject non-ending zero parameter */
-    CloseHandle(fd);
-    free(out);
-#if (defined EINVAL)
-    errno = EINVAL;
-#else
-    errno = EDOM;
-#endif /*EINVAL*/
-    return NULL;
+    }
   }
-  /* fix to allocation granularity */{
-    DWORD psize;
-    /* get the allocation granularity */{
-      SYSTEM_INFO s_info;
-      GetSystemInfo(&s_info);
-      psize = s_info.dwAllocationGranularity;
+  /* locate the ring fields */{
+    unsigned char* const sq = (unsigned char*)out->sq_ptr;
+    unsigned char* const cq = (unsigned char*)out->cq_ptr;
+    out->sq_head = (unsigned int*)(sq+params.sq_off.head);
+    out->sq_tail = (unsigned int*)(sq+params.sq_off.tail);
+    out->sq_mask = *(unsigned int*)(sq+params.sq_off.ring_mask);
+    out->sq_array = (unsigned int*)(sq+params.sq_off.array);
+    out->cq_head = (unsigned int*)(cq+params.cq_off.head);
+    out->cq_tail = (unsigned int*)(cq+params.cq_off.tail);
+    out->cq_mask = *(unsigned int*)(cq+params.cq_off.ring_mask);
+    out->cqes = (struct io_uring_cqe*)(cq+params.cq_off.cqes);
+  }
+  /* register the arena, so that reads need not map it each time */{
+    struct iovec iov;
+    size_t i;
+    iov.iov_base = out->arena;
+    iov.iov_len = (size_t)(MMAPTWO_URING_SLOTS)*(size_t)(MMAPTWO_URING_SLOT);
+    out->fixed = (syscall(__NR_io_uring_register, ring,
+        IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+    for (i = 0u; i < (size_t)(MMAPTWO_URING_SLOTS); ++i) {
+      out->free_slots[i] = (size_t)(MMAPTWO_URING_SLOTS)-i;
     }
-    fullsize = sz;
-    if (psize > 0) {
-      /* adjust the offset */
-      fullshift = off;
-      fulloff = (off-fullshift);
-      if (fullshift >= ((~(size_t)0u)-sz)) {
-        /* range fix failure */
-        CloseHandle(fd);
-        free(out);
-        errno = ERANGE;
-        return NULL;
-      } else fullsize += fullshift;
-      /* adjust the size */{
-        size_t size_shift = (fullsize % psize);
-        if (size_shift > 0) {
-          extended_size = fullsize + (psize - size_shift);
-        } else extended_size = fullsize;
+    out->free_count = (size_t)(MMAPTWO_URING_SLOTS);
+  }
+  pthread_mutex_init(&out->lock, NULL);
+  pthread_cond_init(&out->reaped, NULL);
+  out->fd = fd;
+  out->mt = mt;
+  out->offnum = off;
+  out->len = sz;
+  out->refs = 1u;
+  out->base.mmt_dtor = &mmaptwo_urm_dtor;
+  out->base.mmt_acquire = &mmaptwo_urm_acquire;
+  out->base.mmt_length = &mmaptwo_urm_length;
+  out->base.mmt_offset = &mmaptwo_urm_offset;
+  out->base.mmt_acquire_flags = &mmaptwo_urm_acquire_flags;
+  out->base.mmt_acquire_batch = &mmaptwo_urm_acquire_batch;
+  out->base.mmt_fd = &mmaptwo_urm_fd;
+  out->base.mmt_residency = &mmaptwo_urm_residency;
+  out->base.mmt_stats = &mmaptwo_urm_stats;
+  return (struct mmaptwo_i*)out;
+}
+
+void mmaptwo_uring_release(struct mmaptwo_uring* u) {
+  if (mmaptwo_atomic_add(&u->refs, ~(size_t)0u) == 0u) {
+    pthread_cond_destroy(&u->reaped);
+    pthread_mutex_destroy(&u->lock);
+    close(u->fd);
+    mmaptwo_uring_free(u);
+  }
+  return;
+}
+
+void mmaptwo_uring_free(struct mmaptwo_uring* u) {
+  if (u->arena != MAP_FAILED) {
+    munmap(u->arena,
+        (size_t)(MMAPTWO_URING_SLOTS)*(size_t)(MMAPTWO_URING_SLOT));
+  }
+  if (u->sqes != MAP_FAILED)
+    munmap(u->sqes, u->depth*sizeof(struct io_uring_sqe));
+  if (u->cq_ptr != MAP_FAILED && u->cq_ptr != u->sq_ptr)
+    munmap(u->cq_ptr, u->cq_len);
+  if (u->sq_ptr != MAP_FAILED)
+    munmap(u->sq_ptr, u->sq_len);
+  close(u->ring);
+  free(u);
+  return;
+}
+
+void mmaptwo_uring_reap(struct mmaptwo_uring* u) {
+  unsigned int head = *u->cq_head;
+  unsigned int const tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    struct io_uring_cqe const* const cqe = &u->cqes[head & u->cq_mask];
+    struct mmaptwo_uring_req* const req =
+      (struct mmaptwo_uring_req*)(size_t)cqe->user_data;
+    req->res = cqe->res;
+    req->done = 1;
+    u->inflight -= 1u;
+    head += 1u;
+  }
+  __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  return;
+}
+
+int mmaptwo_uring_run
+  (struct mmaptwo_uring* u, size_t n, struct mmaptwo_uring_req* reqs)
+{
+  size_t next = 0u;
+  size_t done = 0u;
+  size_t i;
+  pthread_mutex_lock(&u->lock);
+  while (done < n) {
+    unsigned int pending;
+    /* queue as many reads as the ring takes */{
+      unsigned int tail = *u->sq_tail;
+      while (next < n && u->inflight < u->depth) {
+        struct mmaptwo_uring_req* const req = &reqs[next];
+        unsigned int const idx = tail & u->sq_mask;
+        struct io_uring_sqe* const sqe = &u->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = u->fd;
+        sqe->off = req->off;
+        sqe->user_data = (size_t)req;
+        if (req->slot != 0u && u->fixed) {
+          sqe->opcode = IORING_OP_READ_FIXED;
+          sqe->addr = (size_t)req->data;
+          sqe->len = (unsigned int)req->len;
+          sqe->buf_index = 0;
+        } else {
+          req->iov.iov_base = req->data;
+          req->iov.iov_len = req->len;
+          sqe->opcode = IORING_OP_READV;
+          sqe->addr = (size_t)&req->iov;
+          sqe->len = 1u;
+        }
+        u->sq_array[idx] = idx;
+        tail += 1u;
+        u->inflight += 1u;
+        next += 1u;
+      }
+      __atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+      pending = tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    }
+    if (!u->reaping) {
+      mmaptwo_uring_reap(u);
+    }
+    for (; done < n && reqs[done].done; ++done) {
+      continue;
+    }
+    if (done >= n) {
+      break;
+    } else if (!u->reaping) {
+      /* wait in the kernel on behalf of every thread */
+      long res;
+      u->reaping = 1;
+      pthread_mutex_unlock(&u->lock);
+      res = syscall(__NR_io_uring_enter, u->ring, pending, 1u,
+          IORING_ENTER_GETEVENTS, NULL, 0);
+      pthread_mutex_lock(&u->lock);
+      u->reaping = 0;
+      mmaptwo_uring_reap(u);
+      if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        /* take back the reads the kernel has not consumed, give up on
+         * them and on reads not yet queued, and wait out the rest */
+        int const err = errno;
+        unsigned int const head =
+          __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+        unsigned int tail = *u->sq_tail;
+        while (tail != head) {
+          struct mmaptwo_uring_req* req;
+          tail -= 1u;
+          req = (struct mmaptwo_uring_req*)(size_t)
+            u->sqes[u->sq_array[tail & u->sq_mask]].user_data;
+          req->res = -err;
+          req->done = 1;
+          u->inflight -= 1u;
+        }
+        __atomic_store_n(u->sq_tail, head, __ATOMIC_RELEASE);
+        for (i = next; i < n; ++i) {
+          reqs[i].res = -err;
+          reqs[i].done = 1;
+        }
+        next = n;
       }
+      pthread_cond_broadcast(&u->reaped);
     } else {
-      fulloff = off;
-      fullshift = 0u;
-      extended_size = sz;
+      pthread_cond_wait(&u->reaped, &u->lock);
     }
   }
-  /* prepare the security attributes */{
-    memset(&cfmsa, 0, sizeof(cfmsa));
-    cfmsa.nLength = sizeof(cfmsa);
-    cfmsa.lpSecurityDescriptor = NULL;
-    cfmsa.bInheritHandle = (BOOL)(mt.bequeath ? TRUE : FALSE);
+  pthread_mutex_unlock(&u->lock);
+  /* finish short reads directly */
+  for (i = 0u; i < n; ++i) {
+    struct mmaptwo_uring_req* const req = &reqs[i];
+    size_t got;
+    if (req->res == -EINTR || req->res == -EAGAIN) {
+      req->res = 0;
+    } else if (req->res < 0) {
+      return -req->res;
+    }
+    got = (size_t)req->res;
+    while (got < req->len) {
+      ssize_t const res = pread(u->fd, req->data+got, req->len-got,
+          (off_t)(req->off+got));
+      if (res < 0) {
+        if (errno == EINTR)
+          continue;
+        return errno;
+      } else if (res == 0) {
+        /* end of file */
+        memset(req->data+got, 0, req->len-got);
+        break;
+      }
+      got += (size_t)res;
+    }
   }
-  /* check for potential overflow */{
-    if (fulloff >= ((~(size_t)0u)-extended_size)) {
-      /* range fix failure */
-      CloseHandle(fd);
-      free(out);
-      errno = ERANGE;
-      return NULL;
+  return 0;
+}
+
+int mmaptwo_uring_acquire_many
+  ( struct mmaptwo_uring* u, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages)
+{
+  struct mmaptwo_uring_req* reqs;
+  size_t i;
+  int res = 0;
+  /* check the ranges */
+  for (i = 0u; i < n; ++i) {
+    if (ranges[i].off > u->len
+    ||  ranges[i].siz > u->len - ranges[i].off
+    ||  ranges[i].siz == 0u)
+    {
+      return EDOM;
     }
   }
-  /* create the file mapping object */{
-    /*
-     * clamp size to end of file;
-     * based on https://stackoverflow.com/a/46014637
-     */
-    size_t const fullextent = size_clamp > extended_size+fulloff
-        ? extended_size + fulloff
-        : size_clamp;
-    fmd = CreateFileMappingA(
-        fd, /*hFile*/
-        &cfmsa, /*lpFileMappingAttributes*/
-        mmaptwo_mode_prot_cvt(mt.mode), /*flProtect*/
-        (DWORD)((fullextent>>32)&0xFFffFFff), /*dwMaximumSizeHigh*/
-        (DWORD)(fullextent&0xFFffFFff), /*dwMaximumSizeLow*/
-        NULL /*lpName*/
-      );
+  reqs = calloc(n, sizeof(struct mmaptwo_uring_req));
+  if (reqs == NULL) {
+    return errno;
+  }
+  /* prepare the buffers */
+  for (i = 0u; i < n; ++i) {
+    struct mmaptwo_uring_req* const req = &reqs[i];
+    struct mmaptwo_uring_page* const up =
+      calloc(1, sizeof(struct mmaptwo_uring_page));
+    pages[i] = (struct mmaptwo_page_i*)up;
+    if (up == NULL) {
+      res = errno;
+      break;
+    }
+    up->src = u;
+    up->len = ranges[i].siz;
+    up->offnum = ranges[i].off;
+    if (up->len <= (size_t)(MMAPTWO_URING_SLOT)) {
+      pthread_mutex_lock(&u->lock);
+      if (u->free_count > 0u) {
+        u->free_count -= 1u;
+        up->slot = u->free_slots[u->free_count];
+      }
+      pthread_mutex_unlock(&u->lock);
+    }
+    up->data = (up->slot != 0u)
+      ? u->arena + (up->slot-1u)*(size_t)(MMAPTWO_URING_SLOT)
+      : malloc(up->len);
+    if (up->data == NULL) {
+      res = errno;
+      free(up);
+      pages[i] = NULL;
+      break;
+    }
+    mmaptwo_atomic_add(&u->refs, 1u);
+    mmaptwo_stat_acquire(&u->stats);
+    up->base.mmtp_dtor = &mmaptwo_urp_dtor;
+    up->base.mmtp_get = &mmaptwo_urp_get;
+    up->base.mmtp_getconst = &mmaptwo_urp_getconst;
+    up->base.mmtp_length = &mmaptwo_urp_length;
+    up->base.mmtp_offset = &mmaptwo_urp_offset;
+    up->base.mmtp_residency = &mmaptwo_urp_residency;
+    req->data = up->data;
+    req->len = up->len;
+    req->off = u->offnum + up->offnum;
+    req->slot = up->slot;
   }
-  if (fmd == NULL) {
-    /* file mapping failed */
-    CloseHandle(fd);
-    free(out);
-    return NULL;
+  if (res == 0) {
+    res = mmaptwo_uring_run(u, n, reqs);
   }
-  /* initialize the interface */{
-    out->len = fullsize;
-    out->fd = fd;
-    out->fmd = fmd;
-    out->offnum = off;
-    out->mt = mt;
-    out->base.mmt_dtor = &mmaptwo_mmt_dtor;
-    out->base.mmt_acquire = &mmaptwo_mmt_acquire;
-    out->base.mmt_offset = &mmaptwo_mmt_offset;
-    out->base.mmt_length = &mmaptwo_mmt_length;
+  free(reqs);
+  if (res != 0) {
+    for (i = 0u; i < n && pages[i] != NULL; ++i) {
+      mmaptwo_urp_dtor(pages[i]);
+      pages[i] = NULL;
+    }
   }
-  return (struct mmaptwo_i*)out;
+  return res;
 }
 
-struct mmaptwo_page_i* mmaptwo_mmt_acquire
-  (struct mmaptwo_i* m, size_t sz, size_t pre_off)
+void mmaptwo_urm_dtor(struct mmaptwo_i* m) {
+  mmaptwo_uring_release((struct mmaptwo_uring*)m);
+  return;
+}
+
+struct mmaptwo_page_i* mmaptwo_urm_acquire
+  (struct mmaptwo_i* m, size_t sz, size_t off)
 {
-  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
-  struct mmaptwo_page_win32* out;
-  size_t fullsize;
-  size_t off;
-  size_t fullshift;
-  void *ptr;
-  size_t fulloff;
-  out = calloc(1, sizeof(struct mmaptwo_page_win32));
-  if (out == NULL) {
+  return mmaptwo_urm_acquire_flags(m, sz, off, 0);
+}
+
+struct mmaptwo_page_i* mmaptwo_urm_acquire_flags
+  (struct mmaptwo_i* m, size_t sz, size_t off, int flags)
+{
+  struct mmaptwo_range range;
+  struct mmaptwo_page_i* out = NULL;
+  int res;
+  range.siz = sz;
+  range.off = off;
+  res = mmaptwo_urm_acquire_batch(m, 1u, &range, &out, flags, NULL);
+  if (res != 0) {
+    errno = res;
     return NULL;
   }
-  /* repair input size and offset */{
-    size_t const shifted_len = mu->len - mu->offnum;
-    if (pre_off > shifted_len
-    ||  sz > shifted_len - pre_off
-    ||  sz == 0u)
-    {
-      errno = EDOM;
-      return NULL;
-    }
-    off = pre_off + mu->offnum;
+  return out;
+}
+
+int mmaptwo_urm_acquire_batch
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved)
+{
+  struct mmaptwo_uring* const u = (struct mmaptwo_uring*)m;
+  int res = 0;
+  if (saved != NULL)
+    *saved = 0u;
+  if (n == 0u) {
+    return 0;
   }
-  /* compute new offsets */{
-    DWORD psize;
-    /* get the allocation granularity */{
-      SYSTEM_INFO s_info;
-      GetSystemInfo(&s_info);
-      psize = s_info.dwAllocationGranularity;
+  if (flags & mmaptwo_acquire_resident) {
+    /* check every range before reading any */
+    int cold = 0;
+    size_t i;
+    for (i = 0u; i < n; ++i) {
+      if (ranges[i].off > u->len || ranges[i].siz > u->len-ranges[i].off) {
+        res = EDOM;
+        break;
+      }
+      res = mmaptwo_file_resident
+        (u->fd, u->offnum+ranges[i].off, ranges[i].siz);
+      if (res == MMAPTWO_EWOULDBLOCK) {
+        cold = 1;
+        res = 0;
+      } else if (res != 0) {
+        break;
+      }
     }
-    fullsize = sz;
-    if (psize > 0) {
-      /* adjust the offset */
-      fullshift = off%psize;
-      fulloff = (off-fullshift);
-      if (fullshift >= ((~(size_t)0u)-sz)) {
-        /* range fix failure */
-        free(out);
-        errno = ERANGE;
-        return NULL;
-      } else fullsize += fullshift;
-    } else {
-      fulloff = off;
-      fullshift = 0u;
+    if (res == 0 && cold) {
+      res = MMAPTWO_EWOULDBLOCK;
     }
   }
-  ptr = MapViewOfFile(
-      mu->fmd, /*hFileMappingObject*/
-      mmaptwo_mode_access_cvt(mu->mt), /*dwDesiredAccess*/
-      (DWORD)((fulloff>>32)&0xFFffFFff), /* dwFileOffsetHigh */
-      (DWORD)(fulloff&0xFFffFFff), /* dwFileOffsetLow */
-      (SIZE_T)(fullsize) /* dwNumberOfBytesToMap */
-    );
-  if (ptr == NULL) {
-    free(out);
-    return NULL;
+  if (res == 0) {
+    res = mmaptwo_uring_acquire_many(u, n, ranges, pages);
   }
-  /* initialize the interface */{
-    out->ptr = ptr;
-    out->len = fullsize;
-    out->offnum = pre_off;
-    out->shift = fullshift;
-    out->base.mmtp_dtor = &mmaptwo_mmtp_dtor;
-    out->base.mmtp_get = &mmaptwo_mmtp_get;
-    out->base.mmtp_getconst = &mmaptwo_mmtp_getconst;
-    out->base.mmtp_length = &mmaptwo_mmtp_length;
-    out->base.mmtp_offset = &mmaptwo_mmtp_offset;
+  if (res != 0) {
+    mmaptwo_stat_fail(&u->stats, res);
   }
-  return (struct mmaptwo_page_i*)out;
+  return res;
 }
 
-void mmaptwo_mmtp_dtor(struct mmaptwo_page_i* m) {
-  struct mmaptwo_page_win32* const mu = (struct mmaptwo_page_win32*)m;
-  UnmapViewOfFile(mu->ptr);
-  mu->ptr = NULL;
-  free(mu);
-  return;
+size_t mmaptwo_urm_length(struct mmaptwo_i const* m) {
+  struct mmaptwo_uring const* const u = (struct mmaptwo_uring const*)m;
+  return u->len;
 }
 
-void mmaptwo_mmt_dtor(struct mmaptwo_i* m) {
-  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
-  CloseHandle(mu->fmd);
-  mu->fmd = NULL;
-  CloseHandle(mu->fd);
-  mu->fd = NULL;
-  free(mu);
+size_t mmaptwo_urm_offset(struct mmaptwo_i const* m) {
+  struct mmaptwo_uring const* const u = (struct mmaptwo_uring const*)m;
+  return u->offnum;
+}
+
+int mmaptwo_urm_fd(struct mmaptwo_i const* m) {
+  struct mmaptwo_uring const* const u = (struct mmaptwo_uring const*)m;
+  return u->fd;
+}
+
+int mmaptwo_urm_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset)
+{
+  struct mmaptwo_uring* const u = (struct mmaptwo_uring*)m;
+  return mmaptwo_stat_read(&u->stats, st, reset);
+}
+
+void mmaptwo_urp_dtor(struct mmaptwo_page_i* p) {
+  struct mmaptwo_uring_page* const up = (struct mmaptwo_uring_page*)p;
+  struct mmaptwo_uring* const u = up->src;
+  mmaptwo_stat_release(&u->stats);
+  if (up->slot != 0u) {
+    pthread_mutex_lock(&u->lock);
+    u->free_slots[u->free_count] = up->slot;
+    u->free_count += 1u;
+    pthread_mutex_unlock(&u->lock);
+  } else free(up->data);
+  free(up);
+  mmaptwo_uring_release(u);
   return;
 }
 
-size_t mmaptwo_mmt_offset(struct mmaptwo_i const* m) {
-  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
-  return mu->offnum;
+void* mmaptwo_urp_get(struct mmaptwo_page_i* p) {
+  struct mmaptwo_uring_page* const up = (struct mmaptwo_uring_page*)p;
+  return up->data;
 }
-size_t mmaptwo_mmtp_offset(struct mmaptwo_page_i const* m) {
-  struct mmaptwo_page_win32* const mu = (struct mmaptwo_page_win32*)m;
-  return mu->offnum;
+
+void const* mmaptwo_urp_getconst(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_uring_page const* const up =
+    (struct mmaptwo_uring_page const*)p;
+  return up->data;
 }
 
-size_t mmaptwo_mmt_length(struct mmaptwo_i const* m) {
-  struct mmaptwo_win32* const mu = (struct mmaptwo_win32*)m;
-  return mu->len-mu->offnum;
+size_t mmaptwo_urp_length(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_uring_page const* const up =
+    (struct mmaptwo_uring_page const*)p;
+  return up->len;
 }
-size_t mmaptwo_mmtp_length(struct mmaptwo_page_i const* m) {
-  struct mmaptwo_page_win32* const mu = (struct mmaptwo_page_win32*)m;
-  return mu->len-mu->shift;
+
+size_t mmaptwo_urp_offset(struct mmaptwo_page_i const* p) {
+  struct mmaptwo_uring_page const* const up =
+    (struct mmaptwo_uring_page const*)p;
+  return up->offnum;
 }
 
-void* mmaptwo_mmtp_get(struct mmaptwo_page_i* p) {
-  struct mmaptwo_page_win32* const pu = (struct mmaptwo_page_win32*)p;
-  return ((unsigned char*)pu->ptr)+pu->shift;
+int mmaptwo_urm_residency
+  ( struct mmaptwo_i* m, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident)
+{
+  struct mmaptwo_uring* const u = (struct mmaptwo_uring*)m;
+  if (off > u->len || sz > u->len-off) {
+    return EDOM;
+  }
+  return mmaptwo_file_residency(u->fd, u->offnum+off, sz, bits, resident);
 }
-void const* mmaptwo_mmtp_getconst(struct mmaptwo_page_i const* p) {
-  struct mmaptwo_page_win32 const* const pu =
-    (struct mmaptwo_page_win32 const*)p;
-  return ((unsigned char const*)pu->ptr)+pu->shift;
+
+int mmaptwo_urp_residency
+  ( struct mmaptwo_page_i* p, size_t sz, size_t off, unsigned char* bits,
+    size_t* resident)
+{
+  struct mmaptwo_uring_page* const up = (struct mmaptwo_uring_page*)p;
+  size_t const psize = (size_t)sysconf(_SC_PAGE_SIZE);
+  size_t const lead = ((size_t)up->data)%psize;
+  if (off > up->len || sz > up->len-off) {
+    return EDOM;
+  }
+  return mmaptwo_mincore(up->data-lead, lead+off, sz, bits, resident);
 }
 #endif /*MMAPTWO_OS*/
 /* END   static functions */
@@ -1015,6 +6224,72 @@ int mmaptwo_check_bequeath_stop(void) {
 #endif /*MMAPTWO_OS*/
 }
 
+size_t mmaptwo_get_pool_size(void) {
+  return mmaptwo_atomic_get(&mmaptwo_pool_default);
+}
+
+void mmaptwo_set_pool_size(size_t n) {
+  mmaptwo_atomic_set(&mmaptwo_pool_default, n);
+  return;
+}
+
+size_t mmaptwo_get_lock_limit(void) {
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  struct rlimit lim;
+  if (getrlimit(RLIMIT_MEMLOCK, &lim) != 0) {
+    return 0u;
+  } else if (lim.rlim_cur == RLIM_INFINITY
+    ||  lim.rlim_cur > (rlim_t)(~(size_t)0u))
+  {
+    return ~(size_t)0u;
+  } else return (size_t)lim.rlim_cur;
+#else
+  return 0u;
+#endif /*MMAPTWO_OS*/
+}
+
+size_t mmaptwo_get_huge_page_sizes(size_t* sizes, size_t n) {
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  size_t count = 0u;
+#  if (defined __linux__)
+  DIR* const d = opendir("/sys/kernel/mm/hugepages");
+  struct dirent* ent;
+  if (d == NULL) {
+    return 0u;
+  }
+  while ((ent = readdir(d)) != NULL) {
+    unsigned long kb;
+    size_t i;
+    size_t hsize;
+    if (sscanf(ent->d_name, "hugepages-%lukB", &kb) != 1)
+      continue;
+    hsize = (size_t)kb*1024u;
+    /* insert in increasing order */
+    for (i = (count < n) ? count : n; i > 0u && sizes[i-1u] > hsize; --i) {
+      if (i < n)
+        sizes[i] = sizes[i-1u];
+    }
+    if (i < n)
+      sizes[i] = hsize;
+    count += 1u;
+  }
+  closedir(d);
+#  endif /*__linux__*/
+  return count;
+#elif MMAPTWO_OS == MMAPTWO_OS_WIN32
+  SIZE_T const hsize = GetLargePageMinimum();
+  if (hsize == 0) {
+    return 0u;
+  }
+  if (n > 0u) {
+    sizes[0] = (size_t)hsize;
+  }
+  return 1u;
+#else
+  return 0u;
+#endif /*MMAPTWO_OS*/
+}
+
 size_t mmaptwo_get_page_size(void) {
 #if MMAPTWO_OS == MMAPTWO_OS_UNIX
   return (size_t)(sysconf(_SC_PAGE_SIZE));
@@ -1052,6 +6327,60 @@ size_t mmaptwo_page_offset(struct mmaptwo_page_i const* p) {
   return (*p).mmtp_offset(p);
 }
 
+int mmaptwo_page_advise(struct mmaptwo_page_i* p, int advice) {
+  if ((*p).mmtp_advise == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_advise(p, advice);
+}
+
+int mmaptwo_page_lock(struct mmaptwo_page_i* p, int onfault) {
+  if ((*p).mmtp_lock == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_lock(p, onfault);
+}
+
+int mmaptwo_page_flush(struct mmaptwo_page_i* p, int flags) {
+  if ((*p).mmtp_flush == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_flush(p, (*p).mmtp_length(p), 0u, flags);
+}
+
+int mmaptwo_page_flush_range
+  (struct mmaptwo_page_i* p, size_t siz, size_t off, int flags)
+{
+  if ((*p).mmtp_flush == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_flush(p, siz, off, flags);
+}
+
+int mmaptwo_page_resize(struct mmaptwo_page_i* p, size_t siz) {
+  if ((*p).mmtp_resize == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_resize(p, siz);
+}
+
+int mmaptwo_page_residency
+  ( struct mmaptwo_page_i* p, size_t siz, size_t off,
+    unsigned char* bits, size_t* resident)
+{
+  if ((*p).mmtp_residency == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_residency(p, siz, off, bits, resident);
+}
+
+int mmaptwo_page_unlock(struct mmaptwo_page_i* p) {
+  if ((*p).mmtp_unlock == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*p).mmtp_unlock(p);
+}
+
 void mmaptwo_close(struct mmaptwo_i* m) {
   if (m != NULL) {
     (*m).mmt_dtor(m);
@@ -1065,6 +6394,19 @@ struct mmaptwo_page_i* mmaptwo_acquire
   return (*m).mmt_acquire(m, siz, off);
 }
 
+struct mmaptwo_page_i* mmaptwo_acquire_flags
+  (struct mmaptwo_i* m, size_t siz, size_t off, int flags)
+{
+  if ((*m).mmt_acquire_flags == NULL) {
+    if (flags != 0) {
+      errno = MMAPTWO_ENOSYS;
+      return NULL;
+    }
+    return (*m).mmt_acquire(m, siz, off);
+  }
+  return (*m).mmt_acquire_flags(m, siz, off, flags);
+}
+
 size_t mmaptwo_length(struct mmaptwo_i const* m) {
   return (*m).mmt_length(m);
 }
@@ -1072,6 +6414,121 @@ size_t mmaptwo_length(struct mmaptwo_i const* m) {
 size_t mmaptwo_offset(struct mmaptwo_i const* m) {
   return (*m).mmt_offset(m);
 }
+
+int mmaptwo_pool_stats
+  (struct mmaptwo_i const* m, size_t* hits, size_t* misses)
+{
+  if ((*m).mmt_pool_stats == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_pool_stats(m, hits, misses);
+}
+
+int mmaptwo_acquire_batch
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved)
+{
+  size_t i;
+  int err = 0;
+  if ((*m).mmt_acquire_batch != NULL) {
+    return (*m).mmt_acquire_batch(m, n, ranges, pages, flags, saved);
+  }
+  /* acquire one at a time */
+  if (saved != NULL)
+    *saved = 0u;
+  for (i = 0u; i < n; ++i) {
+    pages[i] = mmaptwo_acquire_flags
+      (m, ranges[i].siz, ranges[i].off, flags & ~mmaptwo_acquire_separate);
+    if (pages[i] == NULL) {
+      err = errno;
+      if (err != MMAPTWO_EWOULDBLOCK
+      ||  !(flags & mmaptwo_acquire_resident))
+      {
+        break;
+      }
+      /* keep going, so that every cold range starts coming in */
+    }
+  }
+  if (err != 0) {
+    size_t const end = (i < n) ? i+1u : n;
+    for (i = 0u; i < end; ++i) {
+      if (pages[i] != NULL)
+        mmaptwo_page_close(pages[i]);
+      pages[i] = NULL;
+    }
+  }
+  return err;
+}
+
+int mmaptwo_set_prefetch(struct mmaptwo_i* m, int on) {
+  if ((*m).mmt_set_prefetch == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_set_prefetch(m, on);
+}
+
+int mmaptwo_prefetch_stats
+  (struct mmaptwo_i* m, struct mmaptwo_prefetch_stats* st)
+{
+  if ((*m).mmt_prefetch_stats == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_prefetch_stats(m, st);
+}
+
+int mmaptwo_residency
+  ( struct mmaptwo_i* m, size_t siz, size_t off,
+    unsigned char* bits, size_t* resident)
+{
+  if ((*m).mmt_residency == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_residency(m, siz, off, bits, resident);
+}
+
+int mmaptwo_get_fd(struct mmaptwo_i const* m) {
+  if ((*m).mmt_fd == NULL) {
+    return -1;
+  }
+  return (*m).mmt_fd(m);
+}
+
+int mmaptwo_extend(struct mmaptwo_i* m, size_t siz) {
+  if ((*m).mmt_extend == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_extend(m, siz);
+}
+
+size_t mmaptwo_locked(struct mmaptwo_i const* m) {
+  if ((*m).mmt_locked == NULL) {
+    return 0u;
+  }
+  return (*m).mmt_locked(m);
+}
+
+int mmaptwo_advise(struct mmaptwo_i* m, int advice) {
+  if ((*m).mmt_advise == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_advise(m, advice);
+}
+
+int mmaptwo_set_cache(struct mmaptwo_i* m, size_t max) {
+  if ((*m).mmt_set_cache == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_set_cache(m, max);
+}
+
+int mmaptwo_cache_stats
+  (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st)
+{
+  if ((*m).mmt_cache_stats == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_cache_stats(m, st);
+}
 /* END   helper functions */
 
 /* BEGIN open functions */
@@ -1081,7 +6538,13 @@ struct mmaptwo_i* mmaptwo_open
 {
   int fd;
   struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse(mode);
-  fd = open(nm, mmaptwo_mode_rw_cvt(mt.mode));
+  if (mt.create && mt.mode != mmaptwo_mode_write) {
+    /* creating needs write access */
+    errno = EINVAL;
+    return NULL;
+  }
+  fd = open(nm, mmaptwo_mode_rw_cvt(mt.mode)
+    | mmaptwo_mode_create_cvt(mt.create), 0666);
   if (fd == -1) {
     /* can't open file, so */return NULL;
   }
@@ -1093,7 +6556,13 @@ struct mmaptwo_i* mmaptwo_u8open
 {
   int fd;
   struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse(mode);
-  fd = open((char const*)nm, mmaptwo_mode_rw_cvt(mt.mode));
+  if (mt.create && mt.mode != mmaptwo_mode_write) {
+    /* creating needs write access */
+    errno = EINVAL;
+    return NULL;
+  }
+  fd = open((char const*)nm, mmaptwo_mode_rw_cvt(mt.mode)
+    | mmaptwo_mode_create_cvt(mt.create), 0666);
   if (fd == -1) {
     /* can't open file, so */return NULL;
   }
@@ -1105,19 +6574,67 @@ struct mmaptwo_i* mmaptwo_wopen
 {
   int fd;
   struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse(mode);
-  char* const mbfn = mmaptwo_wctomb(nm);
+  char* mbfn;
+  if (mt.create && mt.mode != mmaptwo_mode_write) {
+    /* creating needs write access */
+    errno = EINVAL;
+    return NULL;
+  }
+  mbfn = mmaptwo_wctomb(nm);
   if (mbfn == NULL) {
     /* conversion failure, so give up */
     free(mbfn);
     return NULL;
   }
-  fd = open(mbfn, mmaptwo_mode_rw_cvt(mt.mode));
+  fd = open(mbfn, mmaptwo_mode_rw_cvt(mt.mode)
+    | mmaptwo_mode_create_cvt(mt.create), 0666);
   free(mbfn);
   if (fd == -1) {
     /* can't open file, so */return NULL;
   }
   return mmaptwo_open_rest(fd, mt, sz, off);
 }
+
+struct mmaptwo_i* mmaptwo_memopen
+  (char const* nm, char const* mode, size_t sz)
+{
+  int fd;
+  struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse(mode);
+  fd = mmaptwo_memfd((nm != NULL) ? nm : "mmaptwo", mt, &sz);
+  if (fd == -1) {
+    /* can't make the memory file, so */return NULL;
+  }
+  return mmaptwo_open_rest(fd, mt, sz, 0u);
+}
+
+struct mmaptwo_i* mmaptwo_fdopen
+  (int fd, char const* mode, size_t sz, size_t off)
+{
+  struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse(mode);
+  int const fl = fcntl(fd, F_GETFL);
+  if (fl == -1) {
+    /* not an open descriptor, so */return NULL;
+  }
+  if (mt.dup) {
+#if (defined F_DUPFD_CLOEXEC)
+    fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+#else
+    fd = dup(fd);
+#endif /*F_DUPFD_CLOEXEC*/
+    if (fd == -1) {
+      /* can't duplicate, so */return NULL;
+    }
+  }
+  if ((fl & O_ACCMODE) == O_WRONLY
+  ||  (mt.mode == mmaptwo_mode_write && (fl & O_ACCMODE) != O_RDWR))
+  {
+    /* mappings need read access, and write access for 'w' */
+    close(fd);
+    errno = EBADF;
+    return NULL;
+  }
+  return mmaptwo_open_rest(fd, mt, sz, off);
+}
 #elif MMAPTWO_OS == MMAPTWO_OS_WIN32
 struct mmaptwo_i* mmaptwo_open
   (char const* nm, char const* mode, size_t sz, size_t off)
@@ -1196,27 +6713,588 @@ struct mmaptwo_i* mmaptwo_wopen
   }
   return mmaptwo_open_rest(fd, mt, sz, off);
 }
+
+struct mmaptwo_i* mmaptwo_memopen
+  (char const* nm, char const* mode, size_t sz)
+{
+  /* not yet available */
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+}
+
+struct mmaptwo_i* mmaptwo_fdopen
+  (int fd, char const* mode, size_t sz, size_t off)
+{
+  /* not yet available */
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+}
 #else
 struct mmaptwo_i* mmaptwo_open
   (char const* nm, char const* mode, size_t sz, size_t off)
 {
-  /* no-op */
-  return NULL;
+  struct mmaptwo_mode_tag mt = mmaptwo_mode_parse(mode);
+  FILE* fp;
+  if (mt.create && mt.mode != mmaptwo_mode_write) {
+    /* creating needs write access */
+    errno = EINVAL;
+    return NULL;
+  }
+  /* streams are the only backend here */
+  mt.buffer = mmaptwo_mode_buffer;
+  fp = fopen(nm, (mt.mode == mmaptwo_mode_write) ? "r+b" : "rb");
+  if (fp == NULL && mt.mode == mmaptwo_mode_write && mt.create) {
+    fp = fopen(nm, "w+b");
+  }
+  if (fp == NULL) {
+    /* can't open file, so */return NULL;
+  }
+  if (mt.end) /* fix map size */{
+    long xsz;
+    if (fseek(fp, 0L, SEEK_END) != 0 || (xsz = ftell(fp)) < 0L
+    ||  (unsigned long)xsz < off)
+    {
+      sz = 0u /*to fail*/;
+    } else sz = (size_t)((unsigned long)xsz-off);
+  }
+  if (sz == 0u) {
+    fclose(fp);
+    errno = ERANGE;
+    return NULL;
+  }
+  return mmaptwo_buf_make(fp, mt, sz, off);
 }
 
 struct mmaptwo_i* mmaptwo_u8open
   (unsigned char const* nm, char const* mode, size_t sz, size_t off)
 {
-  /* no-op */
-  return NULL;
+  return mmaptwo_open((char const*)nm, mode, sz, off);
 }
 
 struct mmaptwo_i* mmaptwo_wopen
   (wchar_t const* nm, char const* mode, size_t sz, size_t off)
 {
-  /* no-op */
+  struct mmaptwo_i* out;
+  char* const mbfn = mmaptwo_wctomb(nm);
+  if (mbfn == NULL) {
+    /* conversion failure, so give up */
+    return NULL;
+  }
+  out = mmaptwo_open(mbfn, mode, sz, off);
+  free(mbfn);
+  return out;
+}
+
+struct mmaptwo_i* mmaptwo_memopen
+  (char const* nm, char const* mode, size_t sz)
+{
+  /* not available without a mapping backend */
+  (void)nm;
+  (void)mode;
+  (void)sz;
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+}
+
+struct mmaptwo_i* mmaptwo_fdopen
+  (int fd, char const* mode, size_t sz, size_t off)
+{
+  /* not available without a mapping backend */
+  (void)fd;
+  (void)mode;
+  (void)sz;
+  (void)off;
+  errno = MMAPTWO_ENOSYS;
   return NULL;
 }
 #endif /*MMAPTWO_OS*/
 /* END   open functions */
 
+/* BEGIN ring functions */
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+struct mmaptwo_ring* mmaptwo_ring_open(char const* nm, size_t sz) {
+  struct mmaptwo_ring* out;
+  size_t cap = sz;
+  int fd;
+  /* round up to whole pages */{
+    long const psize = sysconf(_SC_PAGE_SIZE);
+    size_t const align = (psize > 0) ? (size_t)psize : 1u;
+    if (cap == 0u || cap > (~(size_t)0u)/4u-align) {
+      errno = ERANGE;
+      return NULL;
+    } else if (cap%align > 0u) {
+      cap += align-cap%align;
+    }
+  }
+  if (nm == NULL) {
+    struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse("w");
+    size_t fdsz = cap;
+    fd = mmaptwo_memfd("mmaptwo_ring", mt, &fdsz);
+  } else {
+    fd = open(nm, mmaptwo_mode_rw_cvt(mmaptwo_mode_write)|O_CREAT, 0666);
+    if (fd != -1 && mmaptwo_file_size_e(fd) < cap
+    &&  ftruncate(fd, (off_t)cap) != 0)
+    {
+      int const err = errno;
+      close(fd);
+      errno = err;
+      fd = -1;
+    }
+  }
+  if (fd == -1) {
+    /* can't get storage, so */return NULL;
+  }
+  out = calloc(1, sizeof(struct mmaptwo_ring));
+  if (out == NULL) {
+    close(fd);
+    return NULL;
+  }
+  /* reserve the address range, then map the storage twice over it */{
+    int const prot = PROT_READ|PROT_WRITE;
+    void* const ptr = mmap(NULL, cap*2u, PROT_NONE,
+#if (defined MAP_ANONYMOUS)
+      MAP_PRIVATE|MAP_ANONYMOUS,
+#else
+      MAP_PRIVATE|MAP_ANON,
+#endif /*MAP_ANONYMOUS*/
+      -1, 0);
+    int err = 0;
+    if (ptr == MAP_FAILED) {
+      err = errno;
+    } else if (mmap(ptr, cap, prot, MAP_SHARED|MAP_FIXED, fd, 0)
+        == MAP_FAILED
+    ||  mmap((unsigned char*)ptr+cap, cap, prot, MAP_SHARED|MAP_FIXED,
+          fd, 0) == MAP_FAILED)
+    {
+      err = errno;
+      munmap(ptr, cap*2u);
+    }
+    /* the mappings keep the storage alive */
+    close(fd);
+    if (err != 0) {
+      free(out);
+      errno = err;
+      return NULL;
+    }
+    out->base = (unsigned char*)ptr;
+  }
+  out->cap = cap;
+  out->head = 0u;
+  out->tail = 0u;
+  out->refs = 1u;
+  return out;
+}
+
+void mmaptwo_ring_close(struct mmaptwo_ring* r) {
+  mmaptwo_ring_release(r);
+  return;
+}
+
+size_t mmaptwo_ring_capacity(struct mmaptwo_ring const* r) {
+  return r->cap;
+}
+
+size_t mmaptwo_ring_readable(struct mmaptwo_ring const* r) {
+  size_t const head = mmaptwo_atomic_get(&r->head);
+  size_t const tail = mmaptwo_atomic_get(&r->tail);
+  return (head >= tail) ? head-tail : head+r->cap*2u-tail;
+}
+
+size_t mmaptwo_ring_writable(struct mmaptwo_ring const* r) {
+  return r->cap - mmaptwo_ring_readable(r);
+}
+
+void* mmaptwo_ring_write_ptr(struct mmaptwo_ring* r) {
+  size_t const head = mmaptwo_atomic_get(&r->head);
+  return r->base + (head%r->cap);
+}
+
+int mmaptwo_ring_commit(struct mmaptwo_ring* r, size_t n) {
+  if (n > mmaptwo_ring_writable(r)) {
+    return EDOM;
+  }
+  mmaptwo_atomic_set(&r->head,
+    mmaptwo_ring_step(r, mmaptwo_atomic_get(&r->head), n));
+  return 0;
+}
+
+void const* mmaptwo_ring_read_ptr(struct mmaptwo_ring const* r) {
+  size_t const tail = mmaptwo_atomic_get(&r->tail);
+  return r->base + (tail%r->cap);
+}
+
+int mmaptwo_ring_consume(struct mmaptwo_ring* r, size_t n) {
+  if (n > mmaptwo_ring_readable(r)) {
+    return EDOM;
+  }
+  mmaptwo_atomic_set(&r->tail,
+    mmaptwo_ring_step(r, mmaptwo_atomic_get(&r->tail), n));
+  return 0;
+}
+
+struct mmaptwo_page_i* mmaptwo_ring_acquire(struct mmaptwo_ring* r) {
+  struct mmaptwo_ring_page* const out =
+    calloc(1, sizeof(struct mmaptwo_ring_page));
+  size_t const tail = mmaptwo_atomic_get(&r->tail);
+  if (out == NULL) {
+    return NULL;
+  }
+  out->len = mmaptwo_ring_readable(r);
+  out->off = tail%r->cap;
+  out->ptr = r->base + out->off;
+  out->src = r;
+  mmaptwo_atomic_add(&r->refs, 1u);
+  out->base.mmtp_dtor = &mmaptwo_ringp_dtor;
+  out->base.mmtp_get = &mmaptwo_ringp_get;
+  out->base.mmtp_getconst = &mmaptwo_ringp_getconst;
+  out->base.mmtp_length = &mmaptwo_ringp_length;
+  out->base.mmtp_offset = &mmaptwo_ringp_offset;
+  return (struct mmaptwo_page_i*)out;
+}
+#else
+struct mmaptwo_ring* mmaptwo_ring_open(char const* nm, size_t sz) {
+  /* not yet available */
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+}
+
+void mmaptwo_ring_close(struct mmaptwo_ring* r) {
+  return;
+}
+
+size_t mmaptwo_ring_capacity(struct mmaptwo_ring const* r) {
+  return 0u;
+}
+
+size_t mmaptwo_ring_readable(struct mmaptwo_ring const* r) {
+  return 0u;
+}
+
+size_t mmaptwo_ring_writable(struct mmaptwo_ring const* r) {
+  return 0u;
+}
+
+void* mmaptwo_ring_write_ptr(struct mmaptwo_ring* r) {
+  return NULL;
+}
+
+int mmaptwo_ring_commit(struct mmaptwo_ring* r, size_t n) {
+  return MMAPTWO_ENOSYS;
+}
+
+void const* mmaptwo_ring_read_ptr(struct mmaptwo_ring const* r) {
+  return NULL;
+}
+
+int mmaptwo_ring_consume(struct mmaptwo_ring* r, size_t n) {
+  return MMAPTWO_ENOSYS;
+}
+
+struct mmaptwo_page_i* mmaptwo_ring_acquire(struct mmaptwo_ring* r) {
+  return NULL;
+}
+#endif /*MMAPTWO_OS*/
+/* END   ring functions */
+
+/* BEGIN prefetch functions */
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+int mmaptwo_prefetch_start(size_t workers, size_t depth) {
+  size_t i;
+  int res = 0;
+  if (workers == 0u || workers > MMAPTWO_PREFETCH_WORKERS
+  ||  depth == 0u || depth > MMAPTWO_PREFETCH_TABLE/2)
+  {
+    return EINVAL;
+  }
+  pthread_mutex_lock(&mmaptwo_prefetch.lock);
+  if (mmaptwo_prefetch.running || mmaptwo_prefetch.stop) {
+    pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+    return EBUSY;
+  }
+  mmaptwo_prefetch.running = 1;
+  mmaptwo_atomic_set(&mmaptwo_prefetch.depth, depth);
+  for (i = 0u; i < workers; ++i) {
+    res = pthread_create(mmaptwo_prefetch.threads+i, NULL,
+        &mmaptwo_prefetch_main, NULL);
+    if (res != 0)
+      break;
+  }
+  mmaptwo_prefetch.workers = i;
+  pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+  if (res != 0) {
+    mmaptwo_prefetch_stop();
+  }
+  return res;
+}
+
+void mmaptwo_prefetch_stop(void) {
+  size_t i;
+  size_t workers;
+  pthread_mutex_lock(&mmaptwo_prefetch.lock);
+  if (!mmaptwo_prefetch.running || mmaptwo_prefetch.stop) {
+    pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+    return;
+  }
+  mmaptwo_prefetch.stop = 1;
+  workers = mmaptwo_prefetch.workers;
+  pthread_cond_broadcast(&mmaptwo_prefetch.work);
+  pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+  for (i = 0u; i < workers; ++i) {
+    pthread_join(mmaptwo_prefetch.threads[i], NULL);
+  }
+  pthread_mutex_lock(&mmaptwo_prefetch.lock);
+  mmaptwo_prefetch.count = 0u;
+  mmaptwo_prefetch.workers = 0u;
+  mmaptwo_prefetch.running = 0;
+  mmaptwo_prefetch.stop = 0;
+  pthread_mutex_unlock(&mmaptwo_prefetch.lock);
+  return;
+}
+#else
+int mmaptwo_prefetch_start(size_t workers, size_t depth) {
+  return MMAPTWO_ENOSYS;
+}
+
+void mmaptwo_prefetch_stop(void) {
+  return;
+}
+#endif /*MMAPTWO_OS*/
+/* END   prefetch functions */
+
+/* BEGIN directory functions */
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+struct mmaptwo_dir* mmaptwo_dir_open(char const* nm, size_t max) {
+  struct mmaptwo_dir* out;
+  int const fd = open(nm, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+  if (fd == -1) {
+    /* can't open the directory, so */return NULL;
+  }
+  out = calloc(1, sizeof(struct mmaptwo_dir));
+  if (out == NULL) {
+    close(fd);
+    return NULL;
+  }
+  out->fd = fd;
+  out->refs = 1u;
+  out->max = max ? max : (size_t)(MMAPTWO_DIR_FDS);
+  return out;
+}
+
+void mmaptwo_dir_close(struct mmaptwo_dir* d) {
+  mmaptwo_dir_release(d);
+  return;
+}
+
+struct mmaptwo_i* mmaptwo_dir_mapopen
+  ( struct mmaptwo_dir* d, char const* nm, char const* mode,
+    size_t sz, size_t off)
+{
+  int fd;
+  struct mmaptwo_mode_tag const mt = mmaptwo_mode_parse(mode);
+  struct mmaptwo_unix* out;
+  struct stat fsi;
+  char* name;
+  size_t const nmlen = strlen(nm);
+  if (mt.buffer || mt.uring) {
+    /* buffered instances keep their descriptor open */
+    errno = EINVAL;
+    return NULL;
+  }
+  if (mt.create && mt.mode != mmaptwo_mode_write) {
+    /* creating needs write access */
+    errno = EINVAL;
+    return NULL;
+  }
+  name = malloc(nmlen+1u);
+  if (name == NULL) {
+    return NULL;
+  }
+  memcpy(name, nm, nmlen+1u);
+  fd = openat(d->fd, nm, mmaptwo_mode_rw_cvt(mt.mode)
+    | mmaptwo_mode_create_cvt(mt.create), 0666);
+  if (fd == -1 || fstat(fd, &fsi) != 0) {
+    /* can't open file, so */
+    int const err = errno;
+    if (fd != -1)
+      close(fd);
+    free(name);
+    errno = err;
+    return NULL;
+  }
+  out = (struct mmaptwo_unix*)mmaptwo_open_rest(fd, mt, sz, off);
+  if (out == NULL) {
+    free(name);
+    return NULL;
+  }
+  out->name = name;
+  out->dev = fsi.st_dev;
+  out->ino = fsi.st_ino;
+  mmaptwo_atomic_add(&d->refs, 1u);
+  mmaptwo_spin_lock(&d->lock);
+  out->dir = d;
+  out->fd_next = d->lru_head;
+  if (d->lru_head != NULL)
+    d->lru_head->fd_prev = out;
+  else d->lru_tail = out;
+  d->lru_head = out;
+  d->fds += 1u;
+  fd = mmaptwo_dir_trim(d, out);
+  mmaptwo_spin_unlock(&d->lock);
+  if (fd != -1)
+    close(fd);
+  return (struct mmaptwo_i*)out;
+}
+
+int mmaptwo_dir_stats
+  (struct mmaptwo_dir* d, struct mmaptwo_dir_stats* st)
+{
+  mmaptwo_spin_lock(&d->lock);
+  st->fds = d->fds;
+  st->max = d->max;
+  st->reopens = d->reopens;
+  st->closes = d->closes;
+  mmaptwo_spin_unlock(&d->lock);
+  return 0;
+}
+#else
+struct mmaptwo_dir* mmaptwo_dir_open(char const* nm, size_t max) {
+  /* not yet available */
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+}
+
+void mmaptwo_dir_close(struct mmaptwo_dir* d) {
+  return;
+}
+
+struct mmaptwo_i* mmaptwo_dir_mapopen
+  ( struct mmaptwo_dir* d, char const* nm, char const* mode,
+    size_t sz, size_t off)
+{
+  /* not yet available */
+  errno = MMAPTWO_ENOSYS;
+  return NULL;
+}
+
+int mmaptwo_dir_stats
+  (struct mmaptwo_dir* d, struct mmaptwo_dir_stats* st)
+{
+  return MMAPTWO_ENOSYS;
+}
+#endif /*MMAPTWO_OS*/
+/* END   directory functions */
+
+
+/* BEGIN statistics functions */
+int mmaptwo_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset)
+{
+  if ((*m).mmt_stats == NULL) {
+    return MMAPTWO_ENOSYS;
+  }
+  return (*m).mmt_stats(m, st, reset);
+}
+
+int mmaptwo_global_stats(struct mmaptwo_stats* st, int reset) {
+  return mmaptwo_stat_read(&mmaptwo_stats_global, st, reset);
+}
+
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX && MMAPTWO_STATS
+int mmaptwo_latency_percentiles
+  ( int op, size_t n, double const* ranks, size_t* values,
+    size_t* count)
+{
+  struct mmaptwo_latency_block* b;
+  size_t* sums;
+  size_t total = 0u;
+  size_t i;
+  if (op < 0 || op >= (int)mmaptwo_latency_ops) {
+    return EINVAL;
+  }
+  for (i = 0u; i < n; ++i) {
+    if (!(ranks[i] >= 0.0 && ranks[i] <= 100.0))
+      return EINVAL;
+  }
+  sums = calloc(MMAPTWO_LATENCY_BUCKETS, sizeof(size_t));
+  if (sums == NULL) {
+    return errno;
+  }
+  /* merge the histograms of every thread */
+  pthread_mutex_lock(&mmaptwo_latency.lock);
+  for (b = mmaptwo_latency.head; b != NULL; b = b->next) {
+    for (i = 0u; i < MMAPTWO_LATENCY_BUCKETS; ++i) {
+      sums[i] += mmaptwo_atomic_get(&b->counts[op][i]);
+    }
+  }
+  pthread_mutex_unlock(&mmaptwo_latency.lock);
+  for (i = 0u; i < MMAPTWO_LATENCY_BUCKETS; ++i) {
+    total += sums[i];
+  }
+  for (i = 0u; i < n; ++i) {
+    double const exact = ranks[i]/100.0*(double)total;
+    size_t target = (size_t)exact;
+    size_t seen = 0u;
+    size_t j;
+    if ((double)target < exact)
+      target += 1u;
+    if (target == 0u)
+      target = 1u;
+    values[i] = 0u;
+    for (j = 0u; j < MMAPTWO_LATENCY_BUCKETS && total > 0u; ++j) {
+      seen += sums[j];
+      if (seen >= target) {
+        values[i] = mmaptwo_latency_bound(j);
+        break;
+      }
+    }
+  }
+  free(sums);
+  if (count != NULL)
+    *count = total;
+  return 0;
+}
+
+int mmaptwo_latency_reset(void) {
+  struct mmaptwo_latency_block* b;
+  pthread_mutex_lock(&mmaptwo_latency.lock);
+  for (b = mmaptwo_latency.head; b != NULL; b = b->next) {
+    size_t i, j;
+    for (i = 0u; i < (size_t)mmaptwo_latency_ops; ++i) {
+      for (j = 0u; j < MMAPTWO_LATENCY_BUCKETS; ++j) {
+        size_t const v = mmaptwo_atomic_get(&b->counts[i][j]);
+        /* subtract, so that counts added meanwhile stay */
+        if (v > 0u)
+          mmaptwo_stat_add(&b->counts[i][j], (~v)+1u);
+      }
+    }
+  }
+  pthread_mutex_unlock(&mmaptwo_latency.lock);
+  return 0;
+}
+#else
+int mmaptwo_latency_percentiles
+  ( int op, size_t n, double const* ranks, size_t* values,
+    size_t* count)
+{
+  (void)op;
+  (void)n;
+  (void)ranks;
+  (void)values;
+  (void)count;
+  return MMAPTWO_ENOSYS;
+}
+
+int mmaptwo_latency_reset(void) {
+  return MMAPTWO_ENOSYS;
+}
+#endif /*MMAPTWO_OS*/
+
+int mmaptwo_set_trace(struct mmaptwo_trace_hooks const* hooks) {
+#if MMAPTWO_OS == MMAPTWO_OS_UNIX
+  mmaptwo_atomic_set(&mmaptwo_trace_table, (size_t)hooks);
+  return 0;
+#else
+  return MMAPTWO_ENOSYS;
+#endif /*MMAPTWO_OS*/
+}
+/* END   statistics functions */
@@ -64,7 +64,385 @@ enum mmaptwo_mode {
    *   to return. Otherwise, the file descriptor of the mapped file
    *   may leak.
    */
-  mmaptwo_mode_bequeath = 0x71
+  mmaptwo_mode_bequeath = 0x71,
+
+  /**
+   * \brief Map the whole mappable region once, at open.
+   * \note When this parameter is active, acquired pages are views into
+   *   the one mapping, which lasts until the map instance and all of its
+   *   pages are closed. Acquiring and closing such pages makes no
+   *   system calls.
+   * \note This parameter currently affects only the Unix backend.
+   */
+  mmaptwo_mode_premap = 0x6d,
+
+  /**
+   * \brief Share mappings among overlapping pages.
+   * \note When this parameter is active, acquiring a page covered by
+   *   another live page of the same map instance makes no new mapping.
+   *   Any other page maps only its own range, which later pages inside
+   *   that range then share. Each mapping lasts until the last page
+   *   using it closes.
+   * \note This parameter currently affects only the Unix backend.
+   */
+  mmaptwo_mode_share = 0x73,
+
+  /**
+   * \brief Fault in the pages of each acquired page before returning it.
+   * \note Acts like passing \link mmaptwo_acquire_populate \endlink
+   *   to every acquisition.
+   * \note This parameter currently affects only the Unix backend.
+   */
+  mmaptwo_mode_populate = 0x66,
+
+  /**
+   * \brief Back mappings with huge pages where possible.
+   * \note When this parameter is active, new mappings start at file
+   *   offsets and addresses aligned to a huge page (`MMAPTWO_HUGE_PAGE`,
+   *   2 MiB by default). Files on `hugetlbfs` map with `MAP_HUGETLB` at
+   *   the file system's page size; other files get `MADV_HUGEPAGE`.
+   * \note This parameter currently affects only the Unix backend.
+   */
+  mmaptwo_mode_huge = 0x68,
+
+  /**
+   * \brief Lock each mapping in memory for its whole lifetime.
+   * \note When this parameter is active, acquisition fails if the
+   *   mapping cannot be locked, for example with `ENOMEM` or `EAGAIN`
+   *   when the lock would exceed `RLIMIT_MEMLOCK`.
+   * \note This parameter currently affects only the Unix backend.
+   */
+  mmaptwo_mode_lock = 0x6c,
+
+  /**
+   * \brief Create the file if it does not exist, then preallocate
+   *   the mappable region.
+   * \note Use with 'w'. The file grows with `posix_fallocate` to cover
+   *   the mappable region, so that writes through the mapping land in
+   *   allocated extents instead of filling holes one fault at a time.
+   *   File systems without preallocation get a sparse file instead.
+   * \note This parameter currently affects only the Unix backend.
+   *   On Windows, writeable files are always created on demand.
+   */
+  mmaptwo_mode_create = 0x63,
+
+  /**
+   * \brief With 'c', reserve the mappable region without growing
+   *   the file.
+   * \note On Linux, this parameter uses `fallocate` with
+   *   `FALLOC_FL_KEEP_SIZE`. The map instance starts at the current end
+   *   of file, which may make it empty, and \link mmaptwo_extend \endlink
+   *   grows the file exactly into the reserved space.
+   * \note This parameter currently affects only the Unix backend.
+   */
+  mmaptwo_mode_keep = 0x6b,
+
+  /**
+   * \brief Seal the length of a memory-backed map instance.
+   * \note Only \link mmaptwo_memopen \endlink uses this parameter.
+   *   On Linux, the memory file gets `F_SEAL_GROW`, `F_SEAL_SHRINK`
+   *   and `F_SEAL_SEAL`, so that neither this process nor a child
+   *   holding the descriptor can change its length.
+   */
+  mmaptwo_mode_seal = 0x7a,
+
+  /**
+   * \brief Duplicate the descriptor instead of taking ownership of it.
+   * \note Only \link mmaptwo_fdopen \endlink uses this parameter.
+   */
+  mmaptwo_mode_dup = 0x64,
+
+  /**
+   * \brief Copy data through explicit reads and writes instead of
+   *   mapping the file.
+   * \note When this parameter is active, each acquired page holds its
+   *   own copy of the range, filled from a block cache (64 KiB blocks,
+   *   `MMAPTWO_BUF_CACHE` bytes or 4 MiB by default) shared by the pages
+   *   of the map instance. Pages of writeable, non-private instances
+   *   write their copy back on \link mmaptwo_page_flush \endlink and,
+   *   if \link mmaptwo_page_get \endlink was called since the last
+   *   whole-page flush, on close. Use this parameter for files or file
+   *   systems that cannot map, or where mapping costs more than copying.
+   * \note On Unix, this parameter uses `pread` and `pwrite`. Where no
+   *   mapping backend exists, \link mmaptwo_open \endlink,
+   *   \link mmaptwo_u8open \endlink and \link mmaptwo_wopen \endlink
+   *   always copy this way, through standard input-output streams.
+   *   On Windows, this parameter has no effect.
+   */
+  mmaptwo_mode_buffer = 0x62,
+
+  /**
+   * \brief Read acquired ranges through `io_uring` instead of mapping
+   *   them.
+   * \note Use with 'r'. When this parameter is active, each acquired
+   *   page holds a copy of its range, read into one of a pool of
+   *   buffers registered with the ring (64 buffers of 16 KiB by
+   *   default) or, for larger ranges, into an own buffer.
+   *   \link mmaptwo_acquire_batch \endlink keeps the reads of all its
+   *   ranges in flight together, which suits small random reads of
+   *   cold files better than page faults.
+   * \note This parameter currently affects only the Linux backend, and
+   *   only in builds that found `linux/io_uring.h`. Where the kernel
+   *   refuses to set up a ring, and with 'w', the map instance maps
+   *   the file as usual.
+   */
+  mmaptwo_mode_uring = 0x75
+};
+
+/**
+ * \brief Page acquisition flags.
+ */
+enum mmaptwo_acquire_flag {
+  /**
+   * \brief Fault in the pages before returning the page instance,
+   *   so that first accesses do not fault.
+   * \note On Unix, this flag uses `MAP_POPULATE` or
+   *   `MADV_POPULATE_READ`/`MADV_POPULATE_WRITE` where available, and
+   *   otherwise reads one byte of each page up to the end of file.
+   *   Population is best-effort; failure to populate does not fail
+   *   the acquisition.
+   */
+  mmaptwo_acquire_populate = 1,
+
+  /**
+   * \brief Give each range of a batch its own mapping.
+   * \note Without this flag, \link mmaptwo_acquire_batch \endlink
+   *   maps neighbouring ranges together, and their pages share
+   *   the mapping.
+   */
+  mmaptwo_acquire_separate = 2,
+
+  /**
+   * \brief Fail at once unless the whole range is in the page cache.
+   * \note With this flag, acquisition checks residency before mapping
+   *   anything, and fails with `EWOULDBLOCK` if any part of the range
+   *   would need a read from storage. The failed acquisition also
+   *   starts bringing the range in, through the prefetch workers of
+   *   \link mmaptwo_prefetch_start \endlink if they run and have room,
+   *   or else through a `POSIX_FADV_WILLNEED` hint, so that a later
+   *   retry is likely to succeed.
+   * \note \link mmaptwo_acquire_batch \endlink checks every range
+   *   before acquiring any, and starts bringing in each cold range.
+   * \note A resident range can still leave the page cache before its
+   *   first access. With 'l', a failure to lock may report `EAGAIN`,
+   *   which equals `EWOULDBLOCK` on some systems.
+   * \note This flag currently works only on Unix.
+   */
+  mmaptwo_acquire_resident = 4
+};
+
+/**
+ * \brief Memory access pattern advice.
+ */
+enum mmaptwo_advice {
+  /** \brief No special treatment. */
+  mmaptwo_advice_normal = 0,
+  /** \brief Expect accesses in order of increasing address. */
+  mmaptwo_advice_sequential = 1,
+  /** \brief Expect accesses in random order; read ahead less. */
+  mmaptwo_advice_random = 2,
+  /** \brief Expect access soon; start reading ahead now. */
+  mmaptwo_advice_willneed = 3,
+  /** \brief Expect no access soon; drop the pages. */
+  mmaptwo_advice_dontneed = 4,
+  /** \brief Expect no access soon; age the pages for reclaim. */
+  mmaptwo_advice_cold = 5,
+  /** \brief Expect no access soon; reclaim the pages now. */
+  mmaptwo_advice_pageout = 6
+};
+
+/**
+ * \brief Page flush flags.
+ */
+enum mmaptwo_flush_flag {
+  /** \brief Wait until the changes reach the file. */
+  mmaptwo_flush_sync = 0,
+  /** \brief Start writing the changes, without waiting. */
+  mmaptwo_flush_async = 1,
+  /** \brief Also invalidate other mappings of the same file. */
+  mmaptwo_flush_invalidate = 2,
+  /**
+   * \brief Write the file's data only, bypassing the mapping.
+   * \note On Linux, this flag uses `sync_file_range` to start writing
+   *   the flushed range. Unless the flush is asynchronous, `fdatasync`
+   *   on the whole file follows, so that the data lasts. Elsewhere,
+   *   this flag uses `fdatasync` on the whole file.
+   * \note This flag skips the mapping, so it cannot be combined with
+   *   \link mmaptwo_flush_invalidate \endlink; flushing fails with
+   *   `EINVAL` instead.
+   */
+  mmaptwo_flush_data = 4
+};
+
+/**
+ * \brief Statistics limits.
+ */
+enum mmaptwo_stats_limit {
+  /**
+   * \brief Number of `errno` values counted one by one; failures
+   *   with other values go to the first slot.
+   */
+  mmaptwo_stats_errnos = 64
+};
+
+/**
+ * \brief Operations timed by the latency histograms.
+ */
+enum mmaptwo_latency_op {
+  /** \brief Opening a map instance. */
+  mmaptwo_latency_open = 0,
+  /** \brief Acquiring a page. */
+  mmaptwo_latency_acquire = 1,
+  /** \brief Closing a page. */
+  mmaptwo_latency_release = 2,
+  /** \brief Flushing a page. */
+  mmaptwo_latency_flush = 3,
+  /** \brief Number of timed operations. */
+  mmaptwo_latency_ops = 4
+};
+
+/**
+ * \brief Ring buffer mapped twice, back to back.
+ */
+struct mmaptwo_ring;
+
+/**
+ * \brief Directory context for opening many files.
+ */
+struct mmaptwo_dir;
+
+/**
+ * \brief Prefetch counters of a map instance.
+ */
+struct mmaptwo_prefetch_stats {
+  /** \brief number of predicted ranges handed to the workers */
+  size_t issued;
+  /** \brief number of predicted ranges acquired later */
+  size_t useful;
+  /** \brief number of predicted ranges forgotten without use */
+  size_t wasted;
+  /**
+   * \brief number of predictions dropped because the queue was full
+   *   or the workers were not running
+   */
+  size_t dropped;
+};
+
+/**
+ * \brief Directory context counters.
+ */
+struct mmaptwo_dir_stats {
+  /** \brief number of open file descriptors */
+  size_t fds;
+  /** \brief budget of open file descriptors */
+  size_t max;
+  /** \brief number of file descriptors reopened on demand */
+  size_t reopens;
+  /** \brief number of idle file descriptors closed to stay in budget */
+  size_t closes;
+};
+
+/**
+ * \brief Operation counters of a map instance, or of the process.
+ */
+struct mmaptwo_stats {
+  /** \brief number of page handles acquired */
+  size_t acquires;
+  /** \brief number of page handles closed */
+  size_t releases;
+  /** \brief number of failed acquisitions */
+  size_t failures;
+  /**
+   * \brief failed acquisitions by `errno` value; the first slot
+   *   counts values out of range
+   */
+  size_t errors[mmaptwo_stats_errnos];
+  /** \brief bytes currently mapped, including cached mappings */
+  size_t mapped;
+  /** \brief greatest number of bytes mapped at once */
+  size_t peak;
+  /** \brief number of live page handles */
+  size_t pages;
+  /** \brief number of mappings made */
+  size_t maps;
+  /** \brief number of mappings removed */
+  size_t unmaps;
+};
+
+struct mmaptwo_i;
+
+/**
+ * \brief Tracing callbacks.
+ * \note Each callback receives `arg`, the map instance, a size and an
+ *   offset into the file data, the duration of the operation in
+ *   nanoseconds, and zero or the `errno` code of a failure. Any
+ *   callback may be `NULL`.
+ * \note Callbacks run on the thread of the operation, and may run on
+ *   many threads at once.
+ */
+struct mmaptwo_trace_hooks {
+  /** \brief user data for the callbacks */
+  void* arg;
+  /**
+   * \brief Called after opening.
+   * \note The instance is `NULL` if opening failed.
+   */
+  void (*open)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err);
+  /**
+   * \brief Called before acquiring a page.
+   * \note The duration is zero.
+   */
+  void (*acquire_begin)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err);
+  /** \brief Called after acquiring a page, or failing to. */
+  void (*acquire_end)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err);
+  /** \brief Called while closing a page, before the instance lets go. */
+  void (*page_close)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err);
+  /** \brief Called after flushing part of a page. */
+  void (*flush)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err);
+  /**
+   * \brief Called after extending an instance.
+   * \note The size is the requested length, and the offset is the
+   *   length before.
+   */
+  void (*extend)
+    ( void* arg, struct mmaptwo_i const* m, size_t siz, size_t off,
+      size_t ns, int err);
+};
+
+/**
+ * \brief Range of a map instance to acquire.
+ */
+struct mmaptwo_range {
+  /** \brief size of the range */
+  size_t siz;
+  /** \brief offset of the range into the file data */
+  size_t off;
+};
+
+/**
+ * \brief Window cache counters.
+ */
+struct mmaptwo_cache_stats {
+  /** \brief number of acquisitions served by the cache */
+  size_t hits;
+  /** \brief number of acquisitions not served by the cache */
+  size_t misses;
+  /** \brief number of mappings evicted to stay within budget */
+  size_t evictions;
+  /** \brief bytes of mappings currently held */
+  size_t bytes;
+  /** \brief budget in bytes */
+  size_t max;
 };
 
 /**
@@ -101,6 +479,62 @@ struct mmaptwo_page_i {
    *   exposed by this interface
    */
   size_t (*mmtp_offset)(struct mmaptwo_page_i const* m);
+  /**
+   * \brief Advise the system how the mapped area will be used.
+   * \param m map instance
+   * \param advice a \link mmaptwo_advice \endlink value
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the page does not support advice.
+   */
+  int (*mmtp_advise)(struct mmaptwo_page_i* m, int advice);
+  /**
+   * \brief Lock the mapped area in memory.
+   * \param m map instance
+   * \param onfault nonzero to lock pages as they fault in, zero to
+   *   fault in and lock all pages now
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the page does not support locking.
+   */
+  int (*mmtp_lock)(struct mmaptwo_page_i* m, int onfault);
+  /**
+   * \brief Unlock the mapped area.
+   * \param m map instance
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the page does not support locking.
+   */
+  int (*mmtp_unlock)(struct mmaptwo_page_i* m);
+  /**
+   * \brief Write changes in part of the mapped area to the file.
+   * \param m map instance
+   * \param siz size of the part to flush
+   * \param off offset of the part from start of page
+   * \param flags bitwise OR of \link mmaptwo_flush_flag \endlink values
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the page does not support flushing.
+   */
+  int (*mmtp_flush)
+    (struct mmaptwo_page_i* m, size_t siz, size_t off, int flags);
+  /**
+   * \brief Change the length of the mapped area.
+   * \param m map instance
+   * \param siz new length of the mapped area
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the page cannot change length.
+   */
+  int (*mmtp_resize)(struct mmaptwo_page_i* m, size_t siz);
+  /**
+   * \brief Check which pages of part of the mapped area are in memory.
+   * \param m map instance
+   * \param siz size of the part to check
+   * \param off offset of the part from start of page
+   * \param[out] bits bitmap of resident pages, or `NULL`
+   * \param[out] resident bytes of the part in resident pages, or `NULL`
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the page cannot check residency.
+   */
+  int (*mmtp_residency)
+    ( struct mmaptwo_page_i* m, size_t siz, size_t off,
+      unsigned char* bits, size_t* resident);
 };
 
 
@@ -136,6 +570,129 @@ struct mmaptwo_i {
    *   exposed by this interface
    */
   size_t (*mmt_offset)(struct mmaptwo_i const* m);
+  /**
+   * \brief Check the page handle pool counters.
+   * \param m map instance
+   * \param[out] hits number of page handles taken from the pool
+   * \param[out] misses number of page handles taken from the heap
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance has no page handle pool.
+   */
+  int (*mmt_pool_stats)
+    (struct mmaptwo_i const* m, size_t* hits, size_t* misses);
+  /**
+   * \brief Set the budget of the cache of recently released mappings.
+   * \param m map instance
+   * \param max budget in bytes; zero disables the cache
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance has no window cache.
+   */
+  int (*mmt_set_cache)(struct mmaptwo_i* m, size_t max);
+  /**
+   * \brief Check the counters of the cache of recently released mappings.
+   * \param m map instance
+   * \param[out] st counters
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance has no window cache.
+   */
+  int (*mmt_cache_stats)
+    (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st);
+  /**
+   * \brief Set the default access pattern advice for acquired pages.
+   * \param m map instance
+   * \param advice a \link mmaptwo_advice \endlink value
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance does not support advice.
+   */
+  int (*mmt_advise)(struct mmaptwo_i* m, int advice);
+  /**
+   * \brief Acquire a page interface into the space, with options.
+   * \param m map instance
+   * \param siz size of the map to acquire
+   * \param off offset from start of mappable interface
+   * \param flags bitwise OR of \link mmaptwo_acquire_flag \endlink values
+   * \return pointer to a page interface on success, NULL otherwise
+   * \note May be NULL if the instance does not support options.
+   */
+  struct mmaptwo_page_i* (*mmt_acquire_flags)
+    (struct mmaptwo_i* m, size_t siz, size_t off, int flags);
+  /**
+   * \brief Check the number of bytes locked in memory.
+   * \param m map instance
+   * \return the number of bytes that the instance and its pages
+   *   hold locked in memory
+   * \note May be NULL if the instance does not support locking.
+   */
+  size_t (*mmt_locked)(struct mmaptwo_i const* m);
+  /**
+   * \brief Extend the mappable area, growing the file if needed.
+   * \param m map instance
+   * \param siz new length of the mappable area
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance cannot grow.
+   */
+  int (*mmt_extend)(struct mmaptwo_i* m, size_t siz);
+  /**
+   * \brief Acquire many ranges at once.
+   * \param m map instance
+   * \param n number of ranges
+   * \param ranges ranges to acquire
+   * \param[out] pages page instances, one for each range
+   * \param flags bitwise OR of \link mmaptwo_acquire_flag \endlink values
+   * \param[out] saved mappings saved, or `NULL`
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance has no batch support.
+   */
+  int (*mmt_acquire_batch)
+    ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+      struct mmaptwo_page_i** pages, int flags, size_t* saved);
+  /**
+   * \brief Get the file descriptor of the mapped file.
+   * \param m map instance
+   * \return the file descriptor, or -1 if none is open
+   * \note May be NULL if the instance has no file descriptor.
+   */
+  int (*mmt_fd)(struct mmaptwo_i const* m);
+  /**
+   * \brief Turn prefetching from acquisition history on or off.
+   * \param m map instance
+   * \param on nonzero to turn on, zero to turn off
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance cannot prefetch.
+   */
+  int (*mmt_set_prefetch)(struct mmaptwo_i* m, int on);
+  /**
+   * \brief Get the prefetch counters.
+   * \param m map instance
+   * \param[out] st counters
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance cannot prefetch.
+   */
+  int (*mmt_prefetch_stats)
+    (struct mmaptwo_i* m, struct mmaptwo_prefetch_stats* st);
+  /**
+   * \brief Check which pages of a range are in the page cache.
+   * \param m map instance
+   * \param siz size of the range
+   * \param off offset of the range into the file data
+   * \param[out] bits bitmap of resident pages, or `NULL`
+   * \param[out] resident bytes of the range in resident pages, or `NULL`
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance cannot check residency.
+   */
+  int (*mmt_residency)
+    ( struct mmaptwo_i* m, size_t siz, size_t off,
+      unsigned char* bits, size_t* resident);
+  /**
+   * \brief Get the operation counters.
+   * \param m map instance
+   * \param[out] st counters
+   * \param reset nonzero to zero the counters after reading them
+   * \return zero on success, an `errno` code otherwise
+   * \note May be NULL if the instance keeps no counters.
+   */
+  int (*mmt_stats)
+    (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset);
 };
 
 /* BEGIN error handling */
@@ -180,6 +737,44 @@ int mmaptwo_check_bequeath_stop(void);
  */
 MMAPTWO_API
 size_t mmaptwo_get_page_size(void);
+
+/**
+ * \brief Check which huge page sizes the system offers.
+ * \param[out] sizes array to receive the sizes, in increasing order
+ * \param n capacity of the array
+ * \return the number of huge page sizes available, which may
+ *   exceed `n`
+ * \note On Linux, this function lists `/sys/kernel/mm/hugepages`.
+ *   On Windows, this function uses `GetLargePageMinimum`.
+ */
+MMAPTWO_API
+size_t mmaptwo_get_huge_page_sizes(size_t* sizes, size_t n);
+
+/**
+ * \brief Check how many bytes a process may lock in memory.
+ * \return the soft `RLIMIT_MEMLOCK` limit, `(size_t)-1` if unlimited,
+ *   or zero if unknown
+ */
+MMAPTWO_API
+size_t mmaptwo_get_lock_limit(void);
+
+/**
+ * \brief Check the number of page handles reserved for each
+ *   newly opened map instance.
+ * \return a page handle count
+ */
+MMAPTWO_API
+size_t mmaptwo_get_pool_size(void);
+
+/**
+ * \brief Set the number of page handles reserved for each
+ *   newly opened map instance.
+ * \param n page handle count; zero disables the pool
+ * \note Acquiring a page from a warm pool avoids the general heap.
+ *   Already-open map instances keep their pool sizes.
+ */
+MMAPTWO_API
+void mmaptwo_set_pool_size(size_t n);
 /* END   configurations */
 
 /* BEGIN helper functions */
@@ -225,6 +820,101 @@ size_t mmaptwo_page_length(struct mmaptwo_page_i const* p);
 MMAPTWO_API
 size_t mmaptwo_page_offset(struct mmaptwo_page_i const* p);
 
+/**
+ * \brief Advise the system how the mapped area will be used.
+ * \param p page instance
+ * \param advice a \link mmaptwo_advice \endlink value
+ * \return zero on success, an `errno` code otherwise
+ * \note On Unix, this function uses `madvise` where available, and
+ *   `posix_madvise` otherwise. Advice the system lacks fails with
+ *   `ENOSYS`.
+ */
+MMAPTWO_API
+int mmaptwo_page_advise(struct mmaptwo_page_i* p, int advice);
+
+/**
+ * \brief Lock the mapped area in memory, to avoid major faults.
+ * \param p page instance
+ * \param onfault nonzero to lock pages as they fault in, zero to
+ *   fault in and lock all pages now
+ * \return zero on success, an `errno` code otherwise; `ENOMEM`,
+ *   `EAGAIN` or `EPERM` usually means the lock would exceed
+ *   `RLIMIT_MEMLOCK` (see \link mmaptwo_get_lock_limit \endlink)
+ * \note On Unix, this function uses `mlock2` with `MLOCK_ONFAULT`
+ *   where available, and `mlock` otherwise. Closing the page unlocks it.
+ * \note Locks do not nest. Unlocking a page also unlocks memory that it
+ *   shares with other pages (in premap or shared-view mode).
+ */
+MMAPTWO_API
+int mmaptwo_page_lock(struct mmaptwo_page_i* p, int onfault);
+
+/**
+ * \brief Unlock the mapped area.
+ * \param p page instance
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_page_unlock(struct mmaptwo_page_i* p);
+
+/**
+ * \brief Write changes in the mapped area to the file.
+ * \param p page instance
+ * \param flags bitwise OR of \link mmaptwo_flush_flag \endlink values
+ * \return zero on success, an `errno` code otherwise
+ * \note On Unix, this function uses `msync` unless `flags` has
+ *   \link mmaptwo_flush_data \endlink. Pages of readonly or private
+ *   map instances have nothing to flush.
+ */
+MMAPTWO_API
+int mmaptwo_page_flush(struct mmaptwo_page_i* p, int flags);
+
+/**
+ * \brief Write changes in part of the mapped area to the file.
+ * \param p page instance
+ * \param siz size of the part to flush
+ * \param off offset of the part from start of page
+ * \param flags bitwise OR of \link mmaptwo_flush_flag \endlink values
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_page_flush_range
+  (struct mmaptwo_page_i* p, size_t siz, size_t off, int flags);
+
+/**
+ * \brief Change the length of the mapped area, keeping its offset.
+ * \param p page instance
+ * \param siz new length of the mapped area
+ * \return zero on success, an `errno` code otherwise
+ * \note The mapped area may move, so get the pointer to the space
+ *   again after this function succeeds. On failure, the page
+ *   remains as it was.
+ * \note On Linux, a page that owns its mapping grows with `mremap`,
+ *   which keeps resident pages in place. Other pages grow by mapping
+ *   the new range before unmapping the old one.
+ */
+MMAPTWO_API
+int mmaptwo_page_resize(struct mmaptwo_page_i* p, size_t siz);
+
+/**
+ * \brief Check which pages of part of the mapped area are in memory.
+ * \param p page instance
+ * \param siz size of the part to check
+ * \param off offset of the part from start of page
+ * \param[out] bits if not `NULL`, receives one bit for each page
+ *   (as from \link mmaptwo_get_page_size \endlink) that the part
+ *   touches, least significant bit first, set for resident pages
+ * \param[out] resident if not `NULL`, receives the number of bytes
+ *   of the part that lie in resident pages
+ * \return zero on success, an `errno` code otherwise
+ * \note The part touches at most `siz/pagesize+2` pages, so a bitmap
+ *   of `(siz/pagesize+9)/8` bytes always suffices.
+ * \note On Unix, this function uses `mincore` on the mapping itself.
+ */
+MMAPTWO_API
+int mmaptwo_page_residency
+  ( struct mmaptwo_page_i* p, size_t siz, size_t off,
+    unsigned char* bits, size_t* resident);
+
 /**
  * \brief Helper function closes the file.
  * \param m map instance
@@ -244,6 +934,101 @@ MMAPTWO_API
 struct mmaptwo_page_i* mmaptwo_acquire
   (struct mmaptwo_i* m, size_t siz, size_t off);
 
+/**
+ * \brief Helper function acquires file data, with options.
+ * \param m map instance
+ * \param siz size of the map to acquire
+ * \param off offset into the file data
+ * \param flags bitwise OR of \link mmaptwo_acquire_flag \endlink values
+ * \return pointer to page interface on success, NULL otherwise
+ */
+MMAPTWO_API
+struct mmaptwo_page_i* mmaptwo_acquire_flags
+  (struct mmaptwo_i* m, size_t siz, size_t off, int flags);
+
+/**
+ * \brief Helper function acquires many ranges of file data at once.
+ * \param m map instance
+ * \param n number of ranges
+ * \param ranges ranges to acquire, in any order
+ * \param[out] pages array of `n` page instances, in the order of
+ *   `ranges`
+ * \param flags bitwise OR of \link mmaptwo_acquire_flag \endlink values
+ * \param[out] saved if not `NULL`, receives the number of mappings
+ *   saved against acquiring each range on its own
+ * \return zero on success, an `errno` code otherwise
+ * \note On Unix, the ranges are sorted by offset, and ranges that
+ *   overlap or lie within one page of each other share one mapping.
+ *   Close each page as usual; the shared mapping lasts until the last
+ *   of them closes.
+ * \note On failure, no page instances remain open.
+ * \note The saved count covers every range that needed no mapping
+ *   of its own, including ranges served from a premap, a shared view
+ *   or a cached mapping.
+ */
+MMAPTWO_API
+int mmaptwo_acquire_batch
+  ( struct mmaptwo_i* m, size_t n, struct mmaptwo_range const* ranges,
+    struct mmaptwo_page_i** pages, int flags, size_t* saved);
+
+/**
+ * \brief Helper function to get the file descriptor of a map instance.
+ * \param m map instance
+ * \return the file descriptor, or -1 if none is open
+ * \note The map instance keeps ownership of the descriptor, which
+ *   stays valid until the instance closes. Use it to wait for events
+ *   or to submit asynchronous reads, but do not close it.
+ * \note Instances from \link mmaptwo_dir_mapopen \endlink may close
+ *   idle descriptors and reopen them later, so this function returns
+ *   -1 for them and sets `errno` to `ENOSYS`.
+ * \note On Windows, this function returns -1.
+ */
+MMAPTWO_API
+int mmaptwo_get_fd(struct mmaptwo_i const* m);
+
+/**
+ * \brief Helper function to turn prefetching on or off for
+ *   a map instance.
+ * \param m map instance
+ * \param on nonzero to turn on, zero to turn off
+ * \return zero on success, an `errno` code otherwise
+ * \note While on, each acquisition feeds a detector of sequential and
+ *   strided offsets. Once a stride repeats, the next ranges along it
+ *   go to the workers started by \link mmaptwo_prefetch_start \endlink.
+ */
+MMAPTWO_API
+int mmaptwo_set_prefetch(struct mmaptwo_i* m, int on);
+
+/**
+ * \brief Helper function to get the prefetch counters of a map instance.
+ * \param m map instance
+ * \param[out] st counters
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_prefetch_stats
+  (struct mmaptwo_i* m, struct mmaptwo_prefetch_stats* st);
+
+/**
+ * \brief Helper function to check which pages of a range of a map
+ *   instance are in the page cache.
+ * \param m map instance
+ * \param siz size of the range
+ * \param off offset of the range into the file data
+ * \param[out] bits if not `NULL`, receives one bit for each page
+ *   that the range touches, as for \link mmaptwo_page_residency \endlink
+ * \param[out] resident if not `NULL`, receives the number of bytes
+ *   of the range that lie in resident pages
+ * \return zero on success, an `errno` code otherwise
+ * \note On Unix, this function maps the range for the duration of
+ *   the call, without faulting it in, and uses `mincore`.
+ * \note The answer may be stale as soon as this function returns.
+ */
+MMAPTWO_API
+int mmaptwo_residency
+  ( struct mmaptwo_i* m, size_t siz, size_t off,
+    unsigned char* bits, size_t* resident);
+
 /**
  * \brief Helper function to check the length of the map instance.
  * \param m map instance
@@ -259,6 +1044,84 @@ size_t mmaptwo_length(struct mmaptwo_i const* m);
  */
 MMAPTWO_API
 size_t mmaptwo_offset(struct mmaptwo_i const* m);
+
+/**
+ * \brief Helper function to check the page handle pool counters.
+ * \param m map instance
+ * \param[out] hits number of page handles taken from the pool
+ * \param[out] misses number of page handles taken from the heap
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_pool_stats
+  (struct mmaptwo_i const* m, size_t* hits, size_t* misses);
+
+/**
+ * \brief Helper function to set the budget of the cache of
+ *   recently released mappings.
+ * \param m map instance
+ * \param max budget in bytes; zero disables the cache
+ * \return zero on success, an `errno` code otherwise
+ * \note Closing a page puts its mapping in the cache, and a later
+ *   acquisition that falls inside a cached mapping reuses it. The
+ *   budget starts at `MMAPTWO_MAX_CACHE` bytes, or at zero for
+ *   private writeable instances, which refuse a nonzero budget.
+ */
+MMAPTWO_API
+int mmaptwo_set_cache(struct mmaptwo_i* m, size_t max);
+
+/**
+ * \brief Helper function to set the default access pattern advice
+ *   for pages acquired later.
+ * \param m map instance
+ * \param advice a \link mmaptwo_advice \endlink value
+ * \return zero on success, an `errno` code otherwise
+ * \note Call this function right after opening to advise every
+ *   mapping of the instance. In premap mode, the advice also applies
+ *   immediately to the whole mapping.
+ */
+MMAPTWO_API
+int mmaptwo_advise(struct mmaptwo_i* m, int advice);
+
+/**
+ * \brief Helper function to check the number of bytes locked in memory.
+ * \param m map instance
+ * \return the number of bytes that the instance and its pages hold
+ *   locked in memory, including cached mappings in lock mode
+ */
+MMAPTWO_API
+size_t mmaptwo_locked(struct mmaptwo_i const* m);
+
+/**
+ * \brief Helper function to extend the mappable area of a map instance,
+ *   growing the file if needed.
+ * \param m map instance
+ * \param siz new length of the mappable area; shorter lengths than
+ *   the current length have no effect
+ * \return zero on success, an `errno` code otherwise
+ * \note Pages acquired earlier remain valid. Later acquisitions may
+ *   cover the new tail.
+ * \note On Unix, the file grows by half its size (up to
+ *   `MMAPTWO_GROW_MAX` bytes) or to the new length, whichever is more,
+ *   using `posix_fallocate` where the file system supports it, and
+ *   `ftruncate` otherwise. Closing the instance trims the file back to
+ *   the end of the mappable area, unless the file size changed in the
+ *   meantime. Readonly instances can extend only over bytes that
+ *   the file already holds.
+ */
+MMAPTWO_API
+int mmaptwo_extend(struct mmaptwo_i* m, size_t siz);
+
+/**
+ * \brief Helper function to check the counters of the cache of
+ *   recently released mappings.
+ * \param m map instance
+ * \param[out] st counters
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_cache_stats
+  (struct mmaptwo_i* m, struct mmaptwo_cache_stats* st);
 /* END   helper functions */
 
 /* BEGIN open functions */
@@ -267,12 +1130,24 @@ size_t mmaptwo_offset(struct mmaptwo_i const* m);
  * \param nm name of file to map
  * \param mode one of 'r' (for readonly) or 'w' (writeable),
  *   optionally followed by 'e' to extend map to end of file,
- *   optionally followed by 'p' to make write changes private
+ *   optionally followed by 'p' to make write changes private,
+ *   optionally followed by 'm' to map the whole region at open,
+ *   optionally followed by 's' to share mappings among pages,
+ *   optionally followed by 'f' to fault in pages at acquisition,
+ *   optionally followed by 'h' to use huge pages,
+ *   optionally followed by 'l' to lock mappings in memory,
+ *   optionally followed by 'c' to create and preallocate the file,
+ *   optionally followed by 'k' to preallocate without growing the file,
+ *   optionally followed by 'b' to copy through reads and writes,
+ *   optionally followed by 'u' to read pages through io_uring
  * \param sz size in bytes of region to provide for mapping
  * \param off file offset of region to provide for mapping
  * \return an interface on success, `NULL` otherwise
  * \note On Windows, this function uses `CreateFileA` directly.
  * \note On Unix, this function uses the `open` system call directly.
+ *   With 'c', the call adds `O_CREAT` and new files get
+ *   permissions 0666 less the process umask. 'c' without 'w'
+ *   fails with `EINVAL` before any file is created.
  */
 MMAPTWO_API
 struct mmaptwo_i* mmaptwo_open
@@ -283,7 +1158,16 @@ struct mmaptwo_i* mmaptwo_open
  * \param nm name of file to map
  * \brief mode one of 'r' (for readonly) or 'w' (writeable),
  *   optionally followed by 'e' to extend map to end of file,
- *   optionally followed by 'p' to make write changes private
+ *   optionally followed by 'p' to make write changes private,
+ *   optionally followed by 'm' to map the whole region at open,
+ *   optionally followed by 's' to share mappings among pages,
+ *   optionally followed by 'f' to fault in pages at acquisition,
+ *   optionally followed by 'h' to use huge pages,
+ *   optionally followed by 'l' to lock mappings in memory,
+ *   optionally followed by 'c' to create and preallocate the file,
+ *   optionally followed by 'k' to preallocate without growing the file,
+ *   optionally followed by 'b' to copy through reads and writes,
+ *   optionally followed by 'u' to read pages through io_uring
  * \param sz size in bytes of region to provide for mapping
  * \param off file offset of region to provide for mapping
  * \return an interface on success, `NULL` otherwise
@@ -300,7 +1184,16 @@ struct mmaptwo_i* mmaptwo_u8open
  * \param nm name of file to map
  * \brief mode one of 'r' (for readonly) or 'w' (writeable),
  *   optionally followed by 'e' to extend map to end of file,
- *   optionally followed by 'p' to make write changes private
+ *   optionally followed by 'p' to make write changes private,
+ *   optionally followed by 'm' to map the whole region at open,
+ *   optionally followed by 's' to share mappings among pages,
+ *   optionally followed by 'f' to fault in pages at acquisition,
+ *   optionally followed by 'h' to use huge pages,
+ *   optionally followed by 'l' to lock mappings in memory,
+ *   optionally followed by 'c' to create and preallocate the file,
+ *   optionally followed by 'k' to preallocate without growing the file,
+ *   optionally followed by 'b' to copy through reads and writes,
+ *   optionally followed by 'u' to read pages through io_uring
  * \param sz size in bytes of region to provide for mapping
  * \param off file offset of region to provide for mapping
  * \return an interface on success, `NULL` otherwise
@@ -312,8 +1205,317 @@ struct mmaptwo_i* mmaptwo_u8open
 MMAPTWO_API
 struct mmaptwo_i* mmaptwo_wopen
   (wchar_t const* nm, char const* mode, size_t sz, size_t off);
+
+/**
+ * \brief Open a zero-filled map instance backed by memory, not by a
+ *   named file.
+ * \param nm name to show for debugging, or `NULL` for a default name
+ * \param mode one of 'r' (for readonly) or 'w' (writeable),
+ *   optionally followed by any mode letter accepted by
+ *   \link mmaptwo_open \endlink, or by 'z' to seal the length
+ * \param sz size in bytes of region to provide for mapping
+ * \return an interface on success, `NULL` otherwise
+ * \note On Linux, this function uses `memfd_create`. With 'h', it first
+ *   tries `MFD_HUGETLB`, rounding the size up to whole huge pages and
+ *   claiming them at once; if that fails, it falls back to an ordinary
+ *   memory file. Other Unix systems use `shm_open` with a name that is
+ *   unlinked at once.
+ * \note Pages of the same map instance see each other's writes, like
+ *   pages of a shared file mapping. With 'q', a child process can
+ *   inherit the memory file too.
+ * \note On Windows, this function currently fails with `ENOSYS`.
+ */
+MMAPTWO_API
+struct mmaptwo_i* mmaptwo_memopen
+  (char const* nm, char const* mode, size_t sz);
+
+/**
+ * \brief Open a map instance from an open file descriptor.
+ * \param fd file descriptor, opened for reading (and writing for 'w')
+ * \param mode one of 'r' (for readonly) or 'w' (writeable),
+ *   optionally followed by any mode letter accepted by
+ *   \link mmaptwo_open \endlink, or by 'd' to duplicate the descriptor
+ * \param sz size in bytes of region to provide for mapping
+ * \param off file offset of region to provide for mapping
+ * \return an interface on success, `NULL` otherwise
+ * \note Without 'd', the map instance takes ownership of `fd` and
+ *   closes it on close, or right away if this function fails. With 'd',
+ *   the instance works on a duplicate, and the caller keeps `fd`.
+ * \note The instance sets or clears the close-on-exec flag of the
+ *   descriptor it uses, according to 'q'.
+ * \note On Windows, this function currently fails with `ENOSYS`.
+ */
+MMAPTWO_API
+struct mmaptwo_i* mmaptwo_fdopen
+  (int fd, char const* mode, size_t sz, size_t off);
 /* END   open functions */
 
+/* BEGIN ring functions */
+/**
+ * \brief Open a ring buffer whose storage is mapped twice, back to back.
+ * \param nm name of a file to keep the storage in, or `NULL`
+ *   for a memory file
+ * \param sz capacity in bytes, rounded up to a whole page
+ * \return a ring buffer on success, `NULL` otherwise
+ * \note Spans that wrap past the end of the storage show up as one
+ *   contiguous span, so callers need neither wrap checks nor copies.
+ * \note A named file is created if needed and grown to the capacity.
+ *   Its contents persist, but the cursors start empty on each open.
+ * \note The cursors support one producer thread and one consumer
+ *   thread at the same time.
+ * \note On Windows, this function currently fails with `ENOSYS`.
+ */
+MMAPTWO_API
+struct mmaptwo_ring* mmaptwo_ring_open(char const* nm, size_t sz);
+
+/**
+ * \brief Close a ring buffer.
+ * \param r the ring buffer to close
+ * \note The storage stays mapped until views from
+ *   \link mmaptwo_ring_acquire \endlink close too.
+ */
+MMAPTWO_API
+void mmaptwo_ring_close(struct mmaptwo_ring* r);
+
+/**
+ * \brief Get the capacity of a ring buffer.
+ * \param r the ring buffer
+ * \return the capacity in bytes
+ */
+MMAPTWO_API
+size_t mmaptwo_ring_capacity(struct mmaptwo_ring const* r);
+
+/**
+ * \brief Get the number of bytes ready for the consumer.
+ * \param r the ring buffer
+ * \return the length of the span at
+ *   \link mmaptwo_ring_read_ptr \endlink
+ */
+MMAPTWO_API
+size_t mmaptwo_ring_readable(struct mmaptwo_ring const* r);
+
+/**
+ * \brief Get the number of bytes free for the producer.
+ * \param r the ring buffer
+ * \return the length of the span at
+ *   \link mmaptwo_ring_write_ptr \endlink
+ */
+MMAPTWO_API
+size_t mmaptwo_ring_writable(struct mmaptwo_ring const* r);
+
+/**
+ * \brief Get the start of the free span, for the producer.
+ * \param r the ring buffer
+ * \return a pointer to the free span
+ */
+MMAPTWO_API
+void* mmaptwo_ring_write_ptr(struct mmaptwo_ring* r);
+
+/**
+ * \brief Publish bytes written to the free span.
+ * \param r the ring buffer
+ * \param n number of bytes to publish
+ * \return zero on success, `EDOM` if `n` exceeds the free span
+ */
+MMAPTWO_API
+int mmaptwo_ring_commit(struct mmaptwo_ring* r, size_t n);
+
+/**
+ * \brief Get the start of the readable span, for the consumer.
+ * \param r the ring buffer
+ * \return a pointer to the readable span
+ */
+MMAPTWO_API
+void const* mmaptwo_ring_read_ptr(struct mmaptwo_ring const* r);
+
+/**
+ * \brief Release bytes from the readable span.
+ * \param r the ring buffer
+ * \param n number of bytes to release
+ * \return zero on success, `EDOM` if `n` exceeds the readable span
+ */
+MMAPTWO_API
+int mmaptwo_ring_consume(struct mmaptwo_ring* r, size_t n);
+
+/**
+ * \brief Acquire a page instance viewing the current readable span.
+ * \param r the ring buffer
+ * \return a page instance on success, `NULL` otherwise
+ * \note The page's offset is the position of the span within the
+ *   storage. Its length is fixed when acquired, and it does not
+ *   consume anything. Close the page before
+ *   \link mmaptwo_ring_consume \endlink releases bytes it still uses.
+ */
+MMAPTWO_API
+struct mmaptwo_page_i* mmaptwo_ring_acquire(struct mmaptwo_ring* r);
+/* END   ring functions */
+
+/* BEGIN prefetch functions */
+/**
+ * \brief Start the process-wide prefetch workers.
+ * \param workers number of worker threads, at most 64
+ * \param depth number of ranges to predict ahead of each acquisition,
+ *   at most 32
+ * \return zero on success, an `errno` code otherwise
+ * \note The workers read predicted ranges into the page cache with
+ *   `readahead` on Linux, or with `posix_fadvise` elsewhere, so that
+ *   later faults on them are minor faults.
+ * \note Fails with `EBUSY` if the workers are already running.
+ * \note On Windows, this function currently fails with `ENOSYS`.
+ */
+MMAPTWO_API
+int mmaptwo_prefetch_start(size_t workers, size_t depth);
+
+/**
+ * \brief Stop the process-wide prefetch workers.
+ * \note Pending predictions are discarded.
+ */
+MMAPTWO_API
+void mmaptwo_prefetch_stop(void);
+/* END   prefetch functions */
+
+/* BEGIN directory functions */
+/**
+ * \brief Open a directory context.
+ * \param nm name of the directory
+ * \param max budget of open file descriptors for the instances opened
+ *   through this context, or zero for the default (`MMAPTWO_DIR_FDS`,
+ *   64 by default)
+ * \return a directory context on success, `NULL` otherwise
+ * \note Instances opened through the context hold their file
+ *   descriptors in a least recently used list. When the list grows
+ *   past the budget, descriptors of idle instances close. Live
+ *   mappings stay valid, and the next operation that needs the
+ *   descriptor reopens it by name, relative to the directory.
+ * \note On Windows, this function currently fails with `ENOSYS`.
+ */
+MMAPTWO_API
+struct mmaptwo_dir* mmaptwo_dir_open(char const* nm, size_t max);
+
+/**
+ * \brief Close a directory context.
+ * \param d the directory context to close
+ * \note The directory descriptor stays open until the instances
+ *   opened through the context close too.
+ */
+MMAPTWO_API
+void mmaptwo_dir_close(struct mmaptwo_dir* d);
+
+/**
+ * \brief Open a file relative to a directory context.
+ * \param d directory context
+ * \param nm name of file to map, relative to the directory
+ * \param mode as for \link mmaptwo_open \endlink
+ * \param sz size in bytes of region to provide for mapping
+ * \param off file offset of region to provide for mapping
+ * \return an interface on success, `NULL` otherwise
+ * \note This function uses `openat`, so that only `nm` is resolved.
+ * \note If the name comes to refer to a different file while the
+ *   descriptor is closed, reopening fails with `ESTALE`.
+ * \note Buffered instances ('b', 'u') need their descriptor
+ *   throughout, so this function fails on 'b' and 'u' with `EINVAL`.
+ */
+MMAPTWO_API
+struct mmaptwo_i* mmaptwo_dir_mapopen
+  ( struct mmaptwo_dir* d, char const* nm, char const* mode,
+    size_t sz, size_t off);
+
+/**
+ * \brief Get the counters of a directory context.
+ * \param d directory context
+ * \param[out] st counters
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_dir_stats
+  (struct mmaptwo_dir* d, struct mmaptwo_dir_stats* st);
+/* END   directory functions */
+
+/* BEGIN statistics functions */
+/**
+ * \brief Get the operation counters of a map instance.
+ * \param m map instance
+ * \param[out] st counters
+ * \param reset nonzero to zero the counters after reading them
+ * \return zero on success, an `errno` code otherwise
+ * \note Resetting zeroes the event counts and sets the peak to the
+ *   bytes mapped now. The bytes mapped and the live page handles
+ *   describe the present, so they stay.
+ * \note The counters update with relaxed atomic operations, so a
+ *   snapshot taken during other operations may mix their effects.
+ * \note Builds configured with `MMAPTWO_STATS` set to zero keep no
+ *   counters, and this function fails with `ENOSYS`.
+ */
+MMAPTWO_API
+int mmaptwo_stats
+  (struct mmaptwo_i* m, struct mmaptwo_stats* st, int reset);
+
+/**
+ * \brief Get the operation counters summed over every map instance
+ *   of the process, including closed ones.
+ * \param[out] st counters
+ * \param reset nonzero to zero the counters after reading them
+ * \return zero on success, an `errno` code otherwise
+ * \note Resetting works as for \link mmaptwo_stats \endlink and
+ *   leaves the counters of each instance alone.
+ */
+MMAPTWO_API
+int mmaptwo_global_stats(struct mmaptwo_stats* st, int reset);
+
+/**
+ * \brief Get latency percentiles of an operation, over every thread
+ *   of the process.
+ * \param op a \link mmaptwo_latency_op \endlink value
+ * \param n number of percentiles
+ * \param ranks percentiles to look up, each from 0 to 100
+ * \param[out] values latency in nanoseconds at each percentile
+ * \param[out] count number of timed operations, or `NULL`
+ * \return zero on success, an `errno` code otherwise
+ * \note Each thread keeps its own log-linear histograms, with 32
+ *   buckets for every power of two, so that a value is at most about
+ *   3% above the true latency. This function sums the histograms of
+ *   every thread, including ones that have exited.
+ * \note Percentiles of an operation never timed come out as zero.
+ * \note On Unix, the timed operations are those of mapped instances:
+ *   opening, \link mmaptwo_acquire \endlink and
+ *   \link mmaptwo_acquire_flags \endlink, closing pages, and
+ *   flushing pages. Elsewhere, or in builds configured with
+ *   `MMAPTWO_STATS` set to zero, this function fails with `ENOSYS`.
+ */
+MMAPTWO_API
+int mmaptwo_latency_percentiles
+  ( int op, size_t n, double const* ranks, size_t* values,
+    size_t* count);
+
+/**
+ * \brief Clear the latency histograms of every thread.
+ * \return zero on success, an `errno` code otherwise
+ */
+MMAPTWO_API
+int mmaptwo_latency_reset(void);
+
+/**
+ * \brief Install tracing callbacks for every map instance.
+ * \param hooks callbacks, or `NULL` to remove them
+ * \return zero on success, an `errno` code otherwise
+ * \note The table must stay valid until replaced, and until the
+ *   callbacks already running return.
+ * \note On Unix, mapped instances call the hooks when opening,
+ *   acquiring with \link mmaptwo_acquire \endlink or
+ *   \link mmaptwo_acquire_flags \endlink, closing pages, flushing
+ *   pages and extending; other instances only when opening. Elsewhere,
+ *   this function fails with `ENOSYS`.
+ * \note Builds that find `<sys/sdt.h>` also hold static probes at
+ *   the same points, under the provider `mmaptwo`: `open`,
+ *   `acquire__begin`, `acquire__end`, `page__close`, `flush` and
+ *   `extend`. Their arguments follow those of the callbacks, without
+ *   `arg`. The probes cost a no-op instruction while no tracer
+ *   attaches to them.
+ */
+MMAPTWO_API
+int mmaptwo_set_trace(struct mmaptwo_trace_hooks const* hooks);
+/* END   statistics functions */
+
 #ifdef __cplusplus
 };
 #endif /*__cplusplus*/
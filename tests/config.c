@@ -8,6 +8,20 @@ int main(int argc, char **argv) {
     mmaptwo_check_bequeath_stop()?"true":"false");
   printf("page size: %lu\n",
     (long unsigned int)mmaptwo_get_page_size());
+  printf("page pool size: %lu\n",
+    (long unsigned int)mmaptwo_get_pool_size());
+  printf("lock limit: %lu\n",
+    (long unsigned int)mmaptwo_get_lock_limit());
+  /* huge page sizes */{
+    size_t sizes[8];
+    size_t const count = mmaptwo_get_huge_page_sizes(sizes, 8);
+    size_t i;
+    fputs("huge page sizes:", stdout);
+    for (i = 0; i < count && i < 8; ++i) {
+      printf(" %lu", (long unsigned int)sizes[i]);
+    }
+    fputs(count ? "\n" : " none\n", stdout);
+  }
   return EXIT_SUCCESS;
 }
 
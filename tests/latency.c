@@ -0,0 +1,79 @@
+#include "../mmaptwo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char const* op_names[mmaptwo_latency_ops] = {
+  "open", "acquire", "release", "flush"
+};
+
+int main(int argc, char **argv) {
+  static double const ranks[] = { 50.0, 90.0, 99.0, 99.9, 99.99, 100.0 };
+  size_t const nranks = sizeof(ranks)/sizeof(ranks[0]);
+  struct mmaptwo_i* mi;
+  char const* fname;
+  char const* mode;
+  size_t len, psize, span;
+  int rounds, i;
+  if (argc < 2) {
+    fputs("usage: latency (file) [mode] [rounds]\n"
+        "Acquire, flush and close every span of a file, then\n"
+        "print latency percentiles in nanoseconds.\n", stderr);
+    return EXIT_FAILURE;
+  }
+  fname = argv[1];
+  mode = (argc>2) ? argv[2] : "re";
+  rounds = (argc>3) ? atoi(argv[3]) : 10;
+  psize = mmaptwo_get_page_size();
+  if (psize == 0)
+    psize = 4096;
+  span = psize*16;
+  for (i = 0; i < rounds; ++i) {
+    size_t off;
+    mmaptwo_set_errno(0);
+    mi = mmaptwo_open(fname, mode, 0, 0);
+    if (mi == NULL) {
+      fprintf(stderr, "failed to open file '%s':\n\t%s\n", fname,
+        strerror(mmaptwo_get_errno()));
+      return EXIT_FAILURE;
+    }
+    len = mmaptwo_length(mi);
+    for (off = 0; off < len; off += span) {
+      size_t const sz = (len-off < span) ? len-off : span;
+      struct mmaptwo_page_i* const pager = mmaptwo_acquire(mi, sz, off);
+      if (pager == NULL) {
+        fprintf(stderr, "failed to map file '%s':\n\t%s\n", fname,
+          strerror(mmaptwo_get_errno()));
+        mmaptwo_close(mi);
+        return EXIT_FAILURE;
+      }
+      mmaptwo_page_flush(pager, mmaptwo_flush_async);
+      mmaptwo_page_close(pager);
+    }
+    mmaptwo_close(mi);
+  }
+  printf("%-8s %10s", "op", "count");
+  for (i = 0; i < (int)nranks; ++i) {
+    char label[16];
+    sprintf(label, "p%g", ranks[i]);
+    printf(" %10s", label);
+  }
+  fputc('\n', stdout);
+  for (i = 0; i < mmaptwo_latency_ops; ++i) {
+    size_t values[sizeof(ranks)/sizeof(ranks[0])];
+    size_t count = 0;
+    size_t j;
+    int const res =
+      mmaptwo_latency_percentiles(i, nranks, ranks, values, &count);
+    if (res != 0) {
+      fprintf(stderr, "failed to get latency:\n\t%s\n", strerror(res));
+      return EXIT_FAILURE;
+    }
+    printf("%-8s %10lu", op_names[i], (long unsigned int)count);
+    for (j = 0; j < nranks; ++j) {
+      printf(" %10lu", (long unsigned int)values[j]);
+    }
+    fputc('\n', stdout);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+#if (defined __unix__) || (defined(__APPLE__)&&defined(__MACH__))
+#  ifndef _POSIX_C_SOURCE
+#    define _POSIX_C_SOURCE 200112L
+#  endif /*_POSIX_C_SOURCE*/
+#  include <unistd.h>
+#  include <fcntl.h>
+#endif /*__unix__*/
+#include "../mmaptwo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+#if (defined CLOCK_MONOTONIC)
+  /* wall time, so that time blocked on fault input counts */
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+  }
+#endif /*CLOCK_MONOTONIC*/
+  return (double)clock()/CLOCKS_PER_SEC;
+}
+
+static int drop_cache(char const* fname) {
+#if (defined POSIX_FADV_DONTNEED)
+  int res;
+  int const fd = open(fname, O_RDONLY);
+  if (fd == -1) {
+    return 0;
+  }
+  res = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+  return res == 0;
+#else
+  (void)fname;
+  return 0;
+#endif /*POSIX_FADV_DONTNEED*/
+}
+
+static double run
+  (struct mmaptwo_i* mi, size_t len, size_t psize, int flags, double* acq)
+{
+  struct mmaptwo_page_i* pager;
+  double start, mid, end;
+  unsigned int sink = 0u;
+  start = now();
+  pager = mmaptwo_acquire_flags(mi, len, 0, flags);
+  mid = now();
+  if (pager == NULL) {
+    return -1.0;
+  } else {
+    unsigned char const volatile* bytes =
+      (unsigned char const volatile*)mmaptwo_page_get_const(pager);
+    size_t i;
+    for (i = 0; i < len; i += psize) {
+      sink += bytes[i];
+    }
+  }
+  end = now();
+  mmaptwo_page_close(pager);
+  (void)sink;
+  *acq = mid-start;
+  return end-mid;
+}
+
+int main(int argc, char **argv) {
+  struct mmaptwo_i* mi;
+  char const* fname;
+  size_t len, psize, pages;
+  int rounds, i;
+  int cold = 1;
+  double totals[2][2] = {{0.0, 0.0}, {0.0, 0.0}};
+  if (argc < 2) {
+    fputs("usage: populate (file) [rounds]\n"
+        "Compare first-access latency of pages acquired\n"
+        "with and without population, dropping the file\n"
+        "from the page cache before each run.\n", stderr);
+    return EXIT_FAILURE;
+  }
+  fname = argv[1];
+  rounds = (argc>2) ? atoi(argv[2]) : 10;
+  mmaptwo_set_errno(0);
+  mi = mmaptwo_open(fname, "re", 0, 0);
+  if (mi == NULL) {
+    fprintf(stderr, "failed to open file '%s':\n\t%s\n", fname,
+      strerror(mmaptwo_get_errno()));
+    return EXIT_FAILURE;
+  }
+  /* measure fresh mappings only */
+  mmaptwo_set_cache(mi, 0);
+  len = mmaptwo_length(mi);
+  psize = mmaptwo_get_page_size();
+  if (psize == 0)
+    psize = 4096;
+  pages = (len+psize-1)/psize;
+  for (i = 0; i < rounds; ++i) {
+    int j;
+    for (j = 0; j < 2; ++j) {
+      double acq = 0.0;
+      double touch;
+      /* start each run from storage, not from the page cache */
+      if (!drop_cache(fname))
+        cold = 0;
+      touch = run(mi, len, psize, j ? mmaptwo_acquire_populate : 0, &acq);
+      if (touch < 0.0) {
+        fprintf(stderr, "failed to map file '%s':\n\t%s\n", fname,
+          strerror(mmaptwo_get_errno()));
+        mmaptwo_close(mi);
+        return EXIT_FAILURE;
+      }
+      totals[j][0] += acq;
+      totals[j][1] += touch;
+    }
+  }
+  printf("%lu pages, %d rounds, %s\n", (long unsigned int)pages, rounds,
+    cold ? "cold cache" : "warm cache (could not drop the page cache)");
+  for (i = 0; i < 2; ++i) {
+    printf("%-12s acquire %10.3f us  first access %8.4f us/page\n",
+      i ? "populate:" : "default:",
+      totals[i][0]*1e6/rounds,
+      totals[i][1]*1e6/((double)rounds*pages));
+  }
+  mmaptwo_close(mi);
+  return EXIT_SUCCESS;
+}